@@ -0,0 +1,163 @@
+#include "container3d.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Compares the memory layouts of Container3D for the access patterns of the calculation phases.
+// The grids are set up like the octree levels in Space, with an element of the size of a Voxel.
+// The loops iterate over x, y, z from the outermost to the innermost loop, like the loops in Space.
+//
+// usage: b_container3d_layout [top level voxels per direction] [octree depth] [repetitions]
+
+struct Element{
+  char type = 0;
+  unsigned char identity = 0;
+};
+
+template <class Layout>
+struct Octree{
+  std::vector<Container3D<Element,Layout>> grid;
+  std::array<unsigned long,3> n_bot;
+
+  Octree(const unsigned long n_top, const int depth){
+    for (int lvl = 0; lvl <= depth; ++lvl){
+      grid.push_back(Container3D<Element,Layout>(n_top << (depth-lvl), n_top << (depth-lvl), n_top << (depth-lvl)));
+    }
+    n_bot = grid[0].getNumElements();
+    // a sphere of "atom" voxels in the centre of the grid
+    const double r = n_bot[0]/3.0;
+    const double c = n_bot[0]/2.0;
+    for (unsigned long x = 0; x < n_bot[0]; ++x){
+      for (unsigned long y = 0; y < n_bot[1]; ++y){
+        for (unsigned long z = 0; z < n_bot[2]; ++z){
+          const double dx = x-c, dy = y-c, dz = z-c;
+          grid[0].getElement(x,y,z).type = (dx*dx + dy*dy + dz*dz < r*r)? 0b11 : 0b1001;
+        }
+      }
+    }
+  }
+};
+
+// type assignment on the octree: each voxel reads its 8 subvoxels on the level below,
+// like splitVoxel and passTypeToChildren
+template <class Layout>
+unsigned long octreeDescent(Octree<Layout>& tree){
+  unsigned long sum = 0;
+  for (size_t lvl = tree.grid.size()-1; lvl > 0; --lvl){
+    const std::array<unsigned long,3> n = tree.grid[lvl].getNumElements();
+    for (unsigned long x = 0; x < n[0]; ++x){
+      for (unsigned long y = 0; y < n[1]; ++y){
+        for (unsigned long z = 0; z < n[2]; ++z){
+          char type = 0;
+          for (unsigned long i = 0; i < 8; ++i){
+            type |= tree.grid[lvl-1].getElement(2*x + (i>>2), 2*y + ((i>>1)&1), 2*z + (i&1)).type;
+          }
+          tree.grid[lvl].getElement(x,y,z).type = type;
+          sum += type;
+        }
+      }
+    }
+  }
+  return sum;
+}
+
+// shell assignment and cavity labelling: each voxel reads its 26 neighbours on the same level,
+// like findPureNeighbours and searchForCore
+template <class Layout>
+unsigned long neighbourScan(Octree<Layout>& tree){
+  unsigned long sum = 0;
+  const std::array<unsigned long,3>& n = tree.n_bot;
+  for (unsigned long x = 1; x < n[0]-1; ++x){
+    for (unsigned long y = 1; y < n[1]-1; ++y){
+      for (unsigned long z = 1; z < n[2]-1; ++z){
+        for (unsigned long dx = x-1; dx <= x+1; ++dx){
+          for (unsigned long dy = y-1; dy <= y+1; ++dy){
+            for (unsigned long dz = z-1; dz <= z+1; ++dz){
+              sum += tree.grid[0].getElement(dx,dy,dz).type == 0b11;
+            }
+          }
+        }
+      }
+    }
+  }
+  return sum;
+}
+
+// surface area: a 2x2x2 window is moved across the bottom level, like evalMarchingCubeConfig
+template <class Layout>
+unsigned long surfaceTally(Octree<Layout>& tree){
+  unsigned long sum = 0;
+  const std::array<unsigned long,3>& n = tree.n_bot;
+  for (unsigned long x = 0; x < n[0]-1; ++x){
+    for (unsigned long y = 0; y < n[1]-1; ++y){
+      for (unsigned long z = 0; z < n[2]-1; ++z){
+        unsigned char config = 0;
+        for (unsigned long i = 0; i < 8; ++i){
+          config |= (tree.grid[0].getElement(x + (i>>2), y + ((i>>1)&1), z + (i&1)).type == 0b11) << i;
+        }
+        sum += config;
+      }
+    }
+  }
+  return sum;
+}
+
+// volume: every voxel on the bottom level is visited once, like tallyVoxelsOfType
+template <class Layout>
+unsigned long volumeTally(Octree<Layout>& tree){
+  unsigned long sum = 0;
+  const std::array<unsigned long,3>& n = tree.n_bot;
+  for (unsigned long x = 0; x < n[0]; ++x){
+    for (unsigned long y = 0; y < n[1]; ++y){
+      for (unsigned long z = 0; z < n[2]; ++z){
+        sum += tree.grid[0].getElement(x,y,z).type == 0b11;
+      }
+    }
+  }
+  return sum;
+}
+
+// returns the shortest time of several repetitions in seconds
+template <class Layout>
+double timePhase(unsigned long (*phase)(Octree<Layout>&), Octree<Layout>& tree, const int n_rep, unsigned long& checksum){
+  double best = 0;
+  for (int rep = 0; rep < n_rep; ++rep){
+    auto start = std::chrono::steady_clock::now();
+    checksum = phase(tree);
+    auto end = std::chrono::steady_clock::now();
+    const double t = std::chrono::duration<double>(end-start).count();
+    if (rep == 0 || t < best){best = t;}
+  }
+  return best;
+}
+
+int main(int argc, char** argv){
+  const unsigned long n_top = argc > 1 ? std::stoul(argv[1]) : 12;
+  const int depth = argc > 2 ? std::stoi(argv[2]) : 4;
+  const int n_rep = argc > 3 ? std::stoi(argv[3]) : 3;
+
+  Octree<RowMajorLayout> row_major(n_top, depth);
+  Octree<MortonLayout> morton(n_top, depth);
+  std::printf("bottom level grid: %lu^3 voxels, depth %d, best of %d\n", row_major.n_bot[0], depth, n_rep);
+  std::printf("%-16s %12s %12s %8s\n", "phase", "row-major/s", "morton/s", "ratio");
+
+  bool consistent = true;
+  auto compare = [&](const char* name, auto phase_row_major, auto phase_morton){
+    unsigned long checksum_row_major = 0, checksum_morton = 0;
+    const double t_row_major = timePhase(phase_row_major, row_major, n_rep, checksum_row_major);
+    const double t_morton = timePhase(phase_morton, morton, n_rep, checksum_morton);
+    consistent &= checksum_row_major == checksum_morton;
+    std::printf("%-16s %12.4f %12.4f %8.2f\n", name, t_row_major, t_morton, t_row_major/t_morton);
+  };
+  compare("octree descent", octreeDescent<RowMajorLayout>, octreeDescent<MortonLayout>);
+  compare("neighbour scan", neighbourScan<RowMajorLayout>, neighbourScan<MortonLayout>);
+  compare("surface tally", surfaceTally<RowMajorLayout>, surfaceTally<MortonLayout>);
+  compare("volume tally", volumeTally<RowMajorLayout>, volumeTally<MortonLayout>);
+
+  if (!consistent){
+    std::printf("error: the layouts produced different results\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
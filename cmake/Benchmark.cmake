@@ -0,0 +1,15 @@
+
+set(BENCHMARK_NAMES
+  container3d_layout
+)
+
+set(MOLOVOL_BENCHMARK_DIR ${CMAKE_SOURCE_DIR}/benchmark)
+
+foreach(BN IN ITEMS ${BENCHMARK_NAMES})
+
+  set(BENCHMARK_SRC_NAME ${BN}.cpp)
+  set(BENCHMARK_EXE_NAME b_${BN})
+  add_executable(${BENCHMARK_EXE_NAME} ${MOLOVOL_BENCHMARK_DIR}/${BENCHMARK_SRC_NAME})
+  set_target_properties(${BENCHMARK_EXE_NAME} PROPERTIES RUNTIME_OUTPUT_DIRECTORY ${CMAKE_BINARY_DIR}/benchmarkbin)
+
+endforeach()
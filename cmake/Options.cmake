@@ -15,6 +15,16 @@ option(
   "Enables unit tests so that test source files are compiled along with executable" 
   OFF
 )
+option(
+  MOLOVOL_BUILD_BENCHMARK
+  "Enables benchmarks so that benchmark source files are compiled along with executable"
+  OFF
+)
+option(
+  MOLOVOL_MORTON_LAYOUT
+  "Store the voxel grids in Morton (Z-curve) order instead of row-major order"
+  OFF
+)
 
 if (CMAKE_MACOSX_BUNDLE AND NOT MOLOVOL_ABS_RESOURCE_PATH)
   message(WARNING "The executable inside a macOS application bundle is always compiled with MOLOVOL_ABS_RESOURCE_PATH enabled")
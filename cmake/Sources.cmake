@@ -2,7 +2,10 @@
 # List of source files
 set(SOURCES
   src/atom.cpp
+  src/atomindex.cpp
   src/atomtree.cpp
+  src/atomkernel.cpp
+  src/bitplane.cpp
   src/base_guicontrol.cpp
   src/base_cmdline.cpp
   src/base_constr.cpp
@@ -10,16 +13,24 @@ set(SOURCES
   src/base_guicontrol.cpp
   src/base_init.cpp
   src/cavity.cpp
+  src/celllist.cpp
   src/controller.cpp
   src/crystallographer.cpp
+  src/distancetransform.cpp
   src/griddata.cpp
   src/importmanager.cpp
   src/misc.cpp
   src/model.cpp
   src/model_filereading.cpp
   src/model_outputfiles.cpp
+  src/model_preflight.cpp
+  src/model_slabs.cpp
   src/space.cpp
+  src/space_distance.cpp
+  src/sparseoctree.cpp
   src/special_chars.cpp
+  src/threadpool.cpp
+  src/unionfind.cpp
   src/vector.cpp
   src/voxel.cpp
 )
@@ -4,11 +4,18 @@ enable_testing()
 # Create a MoloVol library for the test sources to use
 set(TEST_SOURCES
   src/atom.cpp
+  src/atomindex.cpp
   src/atomtree.cpp
+  src/atomkernel.cpp
+  src/celllist.cpp
   src/vector.cpp
   src/importmanager.cpp
   src/crystallographer.cpp
   src/misc.cpp
+  src/unionfind.cpp
+  src/bitplane.cpp
+  src/threadpool.cpp
+  src/distancetransform.cpp
 )
 
 add_library(mvl SHARED ${TEST_SOURCES})
@@ -20,6 +27,12 @@ set(TEST_NAMES
   struct_atom
   class_vector
   class_atomtree
+  class_atomkernel
+  class_celllist
+  class_unionfind
+  class_container3d
+  class_bitplane
+  class_distancetransform
 )
 
 set(MOLOVOL_TEST_DIR ${CMAKE_SOURCE_DIR}/test)
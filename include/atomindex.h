@@ -0,0 +1,38 @@
+#ifndef ATOMINDEX_H
+
+#define ATOMINDEX_H
+
+#include "atom.h"
+#include "atomkernel.h"
+#include "flags.h"
+#include <vector>
+#include <string>
+#include <memory>
+
+// Interface of the spatial indices that find the atoms close to a voxel or a point. Every index
+// stores its own copy of the atoms, in an order that suits its layout, and atom ids refer to the
+// position in its atom list.
+class AtomIndex{
+  public:
+    virtual ~AtomIndex() = default;
+
+    virtual std::string getName() const = 0;
+    virtual double getMaxRad() const = 0;
+    virtual const std::vector<Atom>& getAtomList() const = 0;
+    // combines the relations of all close atoms to a voxel (see AtomKernel). the search ends as
+    // soon as the voxel is found to be completely inside an atom. if a non-negative selection
+    // radius is given, the atoms within it are pushed onto the stack (see
+    // AtomKernel::classifyAndSelect). returns the number of visited tree nodes or grid cells.
+    // the atoms are classified in the precision of the query
+    virtual unsigned long classifyVoxel(const AtomKernel::Query<double>&, unsigned char&, const double, AtomKernel::Stack<double>&) const = 0;
+    virtual unsigned long classifyVoxel(const AtomKernel::Query<float>&, unsigned char&, const float, AtomKernel::Stack<float>&) const = 0;
+    // ids of all atoms whose distance from a point is at most a maximal distance plus their
+    // radius. optionally, returns the number of visited tree nodes or grid cells
+    virtual std::vector<size_t> listAllWithin(const Atom::pos_type, const double, size_t* = nullptr) const = 0;
+
+    // the cell list is chosen automatically for structures that fill their bounding box evenly,
+    // such as crystals, and the atom tree otherwise. the probe radius sets the cell size
+    static std::unique_ptr<AtomIndex> create(const std::vector<Atom>&, const double, const mvINDEX = mvINDEX_AUTO);
+};
+
+#endif
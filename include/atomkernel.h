@@ -0,0 +1,111 @@
+#ifndef ATOMKERNEL_H
+
+#define ATOMKERNEL_H
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Classification of a voxel against a bucket of atoms, whose coordinates and radii are stored in
+// separate arrays (structure of arrays), so that several atoms can be processed at once with SIMD
+// instructions. The relations of all atoms are combined with a bitwise or (see mvREL in flags.h).
+// All comparisons use squared distances and the same operations in the same order, so that every
+// implementation gives identical results. On x86-64, an AVX-512 or AVX2 implementation is selected
+// at runtime, if the CPU supports it. Otherwise, the scalar implementation is used. Every function
+// is available in double (T = double) and in single precision (T = float), which processes twice
+// as many atoms per instruction.
+namespace AtomKernel {
+  // pointers to the first atom of a bucket
+  template<typename T>
+  struct Bucket{
+    const T* x;
+    const T* y;
+    const T* z;
+    const T* rad;
+  };
+
+  // a voxel, given by its centre and the radius of its circumsphere, and the probe radius
+  template<typename T>
+  struct Query{
+    std::array<T,3> pos;
+    T rad_vxl;
+    T rad_probe;
+  };
+
+  // pointers to the arrays that atoms are copied to
+  template<typename T>
+  struct Buffer{
+    T* x;
+    T* y;
+    T* z;
+    T* rad;
+  };
+
+  template<typename T>
+  unsigned char classify(const Bucket<T>&, const size_t, const Query<T>&);
+  template<typename T>
+  unsigned char classifyScalar(const Bucket<T>&, const size_t, const Query<T>&);
+  // classifies a voxel like classify and additionally copies every atom, that is closer than its
+  // touch limit for a voxel of the given selection radius, to the buffer. the relations are
+  // combined with the last argument. returns the number of copied atoms
+  template<typename T>
+  size_t classifyAndSelect(const Bucket<T>&, const size_t, const Query<T>&, const T, const Buffer<T>&, unsigned char&);
+  template<typename T>
+  size_t classifyAndSelectScalar(const Bucket<T>&, const size_t, const Query<T>&, const T, const Buffer<T>&, unsigned char&);
+
+  // distance by which the rounding of the coordinates and of the arithmetic may bring an atom
+  // within the limit of a relation, for coordinates and limits of up to the given magnitude.
+  // searches for close atoms are extended by it, so that they find every atom that the kernel
+  // relates to a voxel
+  template<typename T>
+  double calcRoundingMargin(const double magnitude){
+    return 16 * std::numeric_limits<T>::epsilon() * magnitude;
+  }
+
+  // coordinates and radii of a list of atoms in both precisions
+  class AtomArrays{
+    public:
+      void reserve(const size_t);
+      void push(const double, const double, const double, const double);
+      template<typename T>
+      Bucket<T> getBucket(const size_t offset) const {
+        if constexpr (std::is_same_v<T,float>){
+          return {_x_single.data() + offset, _y_single.data() + offset, _z_single.data() + offset, _rad_single.data() + offset};
+        }
+        else {
+          return {_x.data() + offset, _y.data() + offset, _z.data() + offset, _rad.data() + offset};
+        }
+      }
+    private:
+      std::vector<double> _x, _y, _z, _rad;
+      std::vector<float> _x_single, _y_single, _z_single, _rad_single;
+  };
+
+  // stack of atoms in separate arrays, which grows as needed. a range of atoms on the stack is
+  // addressed by its offset, since growing the stack moves the arrays in memory
+  template<typename T>
+  class Stack{
+    public:
+      size_t size() const {return _size;}
+      // makes room for a number of atoms on top of the stack and returns where to copy them to.
+      // the atoms are added with push
+      Buffer<T> reserve(const size_t);
+      void push(const size_t n){_size += n;}
+      // removes all atoms above the given size
+      void pop(const size_t size){_size = size;}
+      Bucket<T> getBucket(const size_t offset) const {
+        return {_x.data() + offset, _y.data() + offset, _z.data() + offset, _rad.data() + offset};
+      }
+    private:
+      std::vector<T> _x, _y, _z, _rad;
+      size_t _size = 0;
+  };
+
+  // name of the implementation that is selected at runtime
+  std::string getImplementation();
+}
+
+#endif
@@ -3,63 +3,99 @@
 #define ATOMTREE_H
 
 #include "atom.h"
+#include "atomindex.h"
 #include <vector>
 #include <string>
 
-class AtomTree;
+// A node of the implicit k-d tree. The nodes are not stored, instead every node is defined by the
+// range of atoms in the atom list that make up its subtree. The atom of a node is the median of
+// its range and the children are the ranges before and after the median. Ranges that fit into a
+// bucket are leaf nodes, which hold all atoms of their range. The nodes are numbered in the order
+// of a binary heap, which is used to look up the bounds of their subtrees.
 class AtomNode{
   public:
-    AtomNode(AtomTree*, size_t, AtomNode* left_node, AtomNode* right_node);
-    ~AtomNode();
- 
-    const AtomNode* getLeftChild() const;
-    const AtomNode* getRightChild() const;
-    AtomNode* getLeftChild();
-    AtomNode* getRightChild();
-    Atom& getAtom() const;
-    size_t getAtomId() const;
+    AtomNode(const size_t first, const size_t end, const char dim, const size_t index = 0)
+      : _first(first), _end(end), _index(index), _dim(dim) {}
 
-    void print();
+    AtomNode getLeftChild() const {return AtomNode(_first, getMedian(), (_dim+1)%3, 2*_index + 1);}
+    AtomNode getRightChild() const {return AtomNode(getMedian()+1, _end, (_dim+1)%3, 2*_index + 2);}
+    // id of the node's atom. for leaf nodes, id of the first atom of the bucket
+    size_t getAtomId() const {return isLeaf()? _first : getMedian();}
+    // number of atoms held by the node, not by its subtree
+    size_t getNumAtoms() const {return isLeaf()? _end - _first : 1;}
+    // axis along which the children are separated
+    char getDim() const {return _dim;}
+    // range of atoms in the subtree
+    size_t getFirst() const {return _first;}
+    size_t getEnd() const {return _end;}
+    size_t getIndex() const {return _index;}
+    bool isLeaf() const {return _end - _first <= s_bucket_size;}
+
+    // largest number of atoms in a leaf node
+    static constexpr size_t s_bucket_size = 16;
   private:
-    // TODO: Reevaluate whether each node needs to know their parent tree. This
-    // is only used for accessing atoms from nodes directly which is only used
-    // by the voxel class. Atom access could go through atom tree directly
-    AtomTree* _parent_tree;
-    AtomNode* _left_child;
-    AtomNode* _right_child;
-    size_t _atom_id;
+    size_t _first;
+    size_t _end;
+    size_t _index;
+    char _dim;
+
+    size_t getMedian() const {return _first + (_end - _first)/2;}
 };
 
-class AtomTree{
+class AtomTree : public AtomIndex{
   public:
-    friend AtomNode;
-
-    typedef Atom::num_type num_type;  
+    typedef Atom::num_type num_type;
     typedef Atom::pos_type pos_type;
 
     AtomTree();
     AtomTree(const std::vector<Atom>& list_of_atoms);
-    ~AtomTree();
-    // TODO: Move and copy operators
-    
-    const AtomNode* getRoot() const;
 
-    const double getMaxRad() const;
-    const std::vector<Atom>& getAtomList() const;
+    AtomNode getRoot() const;
 
-    std::vector<size_t> listAllWithin(Atom::pos_type, const double) const;
+    std::string getName() const override {return "atom tree";}
+    double getMaxRad() const override;
+    // the atoms are reordered when the tree is built
+    const std::vector<Atom>& getAtomList() const override;
+    const Atom& getAtom(const AtomNode&) const;
+    template<typename T>
+    AtomKernel::Bucket<T> getBucket(const AtomNode& node) const {return _atom_arrays.getBucket<T>(node.getAtomId());}
+    // squared distance from a point to the box around the atom centres of a subtree, and the
+    // largest radius in the subtree
+    num_type calcSqrDistToSubtree(const AtomNode&, const pos_type&) const;
+    num_type getMaxRadInSubtree(const AtomNode& node) const {return _subtree_bounds[node.getIndex()].max_rad;}
+
+    unsigned long classifyVoxel(const AtomKernel::Query<double>&, unsigned char&, const double, AtomKernel::Stack<double>&) const override;
+    unsigned long classifyVoxel(const AtomKernel::Query<float>&, unsigned char&, const float, AtomKernel::Stack<float>&) const override;
+    std::vector<size_t> listAllWithin(const pos_type, const double, size_t* = nullptr) const override;
 
     void print() const;
   private:
-    AtomNode* _root;
     double _max_rad;
+    // largest absolute value of any coordinate, which bounds the rounding errors
+    double _max_coord;
     std::vector<Atom> _atom_list;
-    
-    AtomNode* buildTree(size_t, size_t, char);
-  
-    std::vector<Atom>& getAtomList();
-    void quicksort(const size_t, const size_t, const char);
-    void swap(Atom&, Atom&);
+    // coordinates and radii in the order of the atom list, for the classification of voxels
+    AtomKernel::AtomArrays _atom_arrays;
+    struct SubtreeBounds{
+      pos_type lower;
+      pos_type upper;
+      num_type max_rad;
+    };
+    // indexed by the node index
+    std::vector<SubtreeBounds> _subtree_bounds;
+
+    struct BuildEntry{
+      pos_type pos;
+      size_t id;
+    };
+    void buildTree(std::vector<BuildEntry>&, const AtomNode&);
+    void storeAtomArrays();
+    SubtreeBounds calcSubtreeBounds(const AtomNode&);
+    template<typename T>
+    unsigned long classifyVoxelInPrecision(const AtomKernel::Query<T>&, unsigned char&, const T, AtomKernel::Stack<T>&) const;
+    template<typename T>
+    void traverseTree(const AtomNode&, const AtomKernel::Query<T>&, unsigned char&, const T, const double, AtomKernel::Stack<T>&, unsigned long&) const;
+    void printNode(const AtomNode&) const;
 };
 
 #endif
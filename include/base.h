@@ -46,7 +46,7 @@ class MainApp: public wxApp
 
 wxDECLARE_EVENT(wxEVT_COMMAND_WORKERTHREAD_COMPLETED, wxThreadEvent);
 
-template <typename> class Container3D;
+#include "container3d.h"
 class Voxel;
 class RenderFrame;
 struct Atom;
@@ -67,7 +67,7 @@ class MainFrame: public wxFrame, public wxThreadHelper
     void extSetProgressBar(const int);
     void extDisplayCavityList(const GridData&);
     void extRenderSurface(const Container3D<Voxel>&, const std::array<double,3>, const double, 
-        const bool, const unsigned char, const std::vector<Atom>&);
+        const bool, const size_t, const std::vector<Atom>&);
 
     bool receivedAbortCommand();
 
@@ -89,6 +89,7 @@ class MainFrame: public wxFrame, public wxThreadHelper
     bool getMakeCavityMaps();
     std::string getOutputDir();
     const Container3D<Voxel>& getSurfaceData() const;
+    CavityID getCavityID(const std::array<unsigned,3>&) const;
     void enableGuiElements(bool inp); // method to turn interactable gui elements on or off
 
     void displayAtomList(std::vector<std::tuple<std::string, int, double>> symbol_number_radius);
@@ -111,7 +112,7 @@ class MainFrame: public wxFrame, public wxThreadHelper
     void setProgressBar(const int);
     void displayCavityList(const GridData&);
     void renderSurface(const Container3D<Voxel>&, const std::array<double,3>, 
-      const double, const std::pair<bool,unsigned char>);
+      const double, const std::pair<bool,size_t>);
     void renderMolecule(const std::vector<Atom>&);
 
     void openErrorDialog(const std::pair<int,std::string>&);
@@ -0,0 +1,48 @@
+#ifndef BITPLANE_H
+
+#define BITPLANE_H
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Stores a single flag per voxel, e.g., whether it is solid, for a box of voxels on one level.
+// The bits are packed along x into 64 bit words, so that 64 neighbouring voxels can be
+// processed at once. Every row along x starts with a new word. Bits past the end of a row
+// are always zero.
+class BitPlane{
+  public:
+    typedef uint64_t word_type;
+    static constexpr unsigned word_bits = 64;
+
+    BitPlane() = default;
+    // box from the start index (inclusive) to the end index (exclusive)
+    BitPlane(const std::array<unsigned,3>&, const std::array<unsigned,3>&);
+
+    const std::array<unsigned,3>& getStart() const {return _start;}
+    const std::array<unsigned,3>& getEnd() const {return _end;}
+    size_t getNumWordsPerRow() const {return _n_words_per_row;}
+
+    bool getBit(const std::array<unsigned,3>&) const;
+    void setBit(const std::array<unsigned,3>&);
+    // sets the bits of n consecutive voxels along x, starting at the index
+    void setBits(const std::array<unsigned,3>&, const unsigned);
+    // returns the i-th word of the row at y,z. bits of the word correspond to the voxels
+    // start_x + i*64 + [0,64). returns zero for a word past the end of the row
+    word_type getWord(const size_t i, const unsigned y, const unsigned z) const {
+      return i < _n_words_per_row? _words[calcRowStart(y,z) + i] : 0;
+    }
+
+  private:
+    std::array<unsigned,3> _start = {0,0,0};
+    std::array<unsigned,3> _end = {0,0,0};
+    size_t _n_words_per_row = 0;
+    std::vector<word_type> _words;
+
+    size_t calcRowStart(const unsigned y, const unsigned z) const {
+      return ((z - _start[2]) * size_t(_end[1] - _start[1]) + (y - _start[1])) * _n_words_per_row;
+    }
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CELLLIST_H
+
+#define CELLLIST_H
+
+#include "atomindex.h"
+#include <array>
+#include <vector>
+#include <string>
+
+// Uniform grid of cubic cells over the bounding box of the atoms. The atoms are sorted by their
+// cell in row-major order with x running fastest, and every cell stores where its atoms begin
+// (compressed buckets). The atoms of a row of consecutive cells along x are therefore stored
+// contiguously and are classified as a single bucket. For fixed-radius queries in structures
+// that fill their bounding box evenly, this is faster than descending the atom tree.
+class CellList : public AtomIndex{
+  public:
+    typedef Atom::num_type num_type;
+    typedef Atom::pos_type pos_type;
+
+    CellList();
+    CellList(const std::vector<Atom>&, const num_type);
+
+    std::string getName() const override {return "cell list";}
+    double getMaxRad() const override;
+    const std::vector<Atom>& getAtomList() const override;
+    unsigned long classifyVoxel(const AtomKernel::Query<double>&, unsigned char&, const double, AtomKernel::Stack<double>&) const override;
+    unsigned long classifyVoxel(const AtomKernel::Query<float>&, unsigned char&, const float, AtomKernel::Stack<float>&) const override;
+    std::vector<size_t> listAllWithin(const pos_type, const double, size_t* = nullptr) const override;
+
+    num_type getCellSize() const {return _cell_size;}
+    const std::array<size_t,3>& getNumCells() const {return _n_cells;}
+    // fraction of cells that contain at least one atom
+    double getOccupancy() const;
+
+    // largest number of cells per atom. the cells are enlarged for sparse structures, so that
+    // the grid does not use much more memory than the atoms
+    static constexpr size_t s_max_cells_per_atom = 8;
+  private:
+    num_type _max_rad = 0;
+    // largest absolute value of any coordinate, which bounds the rounding errors
+    num_type _max_coord = 0;
+    num_type _cell_size = 1;
+    pos_type _origin = {0,0,0};
+    std::array<size_t,3> _n_cells = {0,0,0};
+    std::vector<Atom> _atom_list;
+    AtomKernel::AtomArrays _atom_arrays;
+    // index of the first atom of every cell, followed by the number of atoms
+    std::vector<size_t> _cell_start;
+
+    size_t calcCellIndex(const std::array<size_t,3>&) const;
+    size_t findCell(const num_type, const char) const;
+    bool findCellRange(const pos_type&, const num_type, std::array<size_t,3>&, std::array<size_t,3>&) const;
+    num_type calcSqrDistToRow(const pos_type&, const size_t, const size_t) const;
+    template<typename T>
+    unsigned long classifyVoxelInPrecision(const AtomKernel::Query<T>&, unsigned char&, const T, AtomKernel::Stack<T>&) const;
+};
+
+#endif
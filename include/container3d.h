@@ -6,48 +6,121 @@
 #include <cassert>
 #include <array>
 #include <vector>
+#include <cstddef>
 
-template <class T>
+// Layout policies that determine where the element with the index x,y,z is stored in the
+// underlying 1D vector. The strides are computed once when the container is constructed
+
+// x is the fastest changing index, followed by y and z
+class RowMajorLayout{
+  public:
+    RowMajorLayout() = default;
+    RowMajorLayout(const std::array<unsigned long int,3>& n_elements)
+      : _stride_y(n_elements[0]), _stride_z(n_elements[0] * n_elements[1]),
+        _size(n_elements[0] * n_elements[1] * n_elements[2]) {}
+
+    size_t size() const {return _size;}
+
+    size_t calcIndex(const size_t x, const size_t y, const size_t z) const {
+      return z * _stride_z + y * _stride_y + x;
+    }
+
+  private:
+    size_t _stride_y = 0;
+    size_t _stride_z = 0;
+    size_t _size = 0;
+};
+
+// The grid is divided into bricks of 8x8x8 elements. Inside a brick, elements are stored along
+// a Z-order curve (Morton order), with x as the most significant bit, i.e., in the same order as
+// the subvoxels of a voxel. Therefore, every aligned block of 2x2x2 elements, such as the
+// subvoxels of a voxel, is contiguous and neighbouring elements are close in memory. The bricks
+// themselves are stored in row-major order, which limits the padding to less than one brick
+// in each direction, instead of padding the grid to a cube with a power of two side length.
+class MortonLayout{
+  public:
+    static constexpr unsigned brick_bits = 3;
+    static constexpr size_t brick_mask = (size_t(1) << brick_bits) - 1;
+
+    MortonLayout() = default;
+    MortonLayout(const std::array<unsigned long int,3>& n_elements){
+      std::array<size_t,3> n_bricks;
+      for (char dim = 0; dim < 3; ++dim){
+        n_bricks[dim] = (n_elements[dim] + brick_mask) >> brick_bits;
+      }
+      _brick_stride_y = n_bricks[0];
+      _brick_stride_z = n_bricks[0] * n_bricks[1];
+      _size = (n_bricks[0] * n_bricks[1] * n_bricks[2]) << (3*brick_bits);
+    }
+
+    size_t size() const {return _size;}
+
+    size_t calcIndex(const size_t x, const size_t y, const size_t z) const {
+      const size_t brick = (z >> brick_bits) * _brick_stride_z + (y >> brick_bits) * _brick_stride_y + (x >> brick_bits);
+      return (brick << (3*brick_bits))
+        | (spreadBits(x & brick_mask) << 2) | (spreadBits(y & brick_mask) << 1) | spreadBits(z & brick_mask);
+    }
+
+  private:
+    size_t _brick_stride_y = 0;
+    size_t _brick_stride_z = 0;
+    size_t _size = 0;
+
+    // inserts two zero bits after each of the three bits of the index inside a brick: 0bcba -> 0bc00b00a
+    static size_t spreadBits(const size_t i){
+      return (i & 0b1) | ((i & 0b10) << 2) | ((i & 0b100) << 4);
+    }
+};
+
+template <class T, class Layout = RowMajorLayout>
 class Container3D{
   public:
     Container3D() = default;
 
     Container3D(const unsigned long int x, const unsigned long int y, const unsigned long int z){
-      _data = std::vector(x*y*z,T());
       _n_elements[0] = x;
       _n_elements[1] = y;
       _n_elements[2] = z;
+      _layout = Layout(_n_elements);
+      _data = std::vector(_layout.size(),T());
     }
 
     Container3D(const std::array<unsigned long int,3> steps){
-      _data = std::vector(steps[0]*steps[1]*steps[2],T());
       _n_elements = steps;
+      _layout = Layout(_n_elements);
+      _data = std::vector(_layout.size(),T());
     }
-    
-    Container3D(const std::array<unsigned int,3> steps) 
+
+    Container3D(const std::array<unsigned int,3> steps)
       : Container3D((unsigned long) steps[0], (unsigned long) steps[1], (unsigned long) steps[2]){}
-    
+
     /////////////
     // GETTERS //
     /////////////
-    // Single index getter
+    // Single index getter. The index refers to the position in memory, which only coincides
+    // with the order x,y,z for the row-major layout
     T& getElement(const unsigned long int i){return _data[i];}
 
     // XYZ index getter
     template<std::integral INT>
     T& getElement(const INT x, const INT y, const INT z){
-      return _data[z * _n_elements[0] * _n_elements[1] + y * _n_elements[0] + x];
+      return _data[_layout.calcIndex(x, y, z)];
     }
 
     template<std::integral INT>
     const T& getElement(const INT x, const INT y, const INT z) const {
-      return _data[z * _n_elements[0] * _n_elements[1] + y * _n_elements[0] + x];
+      return _data[_layout.calcIndex(x, y, z)];
     }
 
     // These functions should be a template function
     template<std::integral INT>
     T& getElement(const std::array<INT,3> coord){
-      return _data[coord[2] * _n_elements[0] * _n_elements[1] + coord[1] * _n_elements[0] + coord[0]];
+      return _data[_layout.calcIndex(coord[0], coord[1], coord[2])];
+    }
+
+    template<std::integral INT>
+    const T& getElement(const std::array<INT,3> coord) const {
+      return _data[_layout.calcIndex(coord[0], coord[1], coord[2])];
     }
 
     template <typename Q = unsigned long>
@@ -58,10 +131,11 @@ class Container3D{
       }
       return arr;
     }
-  
+
   private:
     std::vector<T> _data;
     std::array<unsigned long int,3> _n_elements;
+    Layout _layout;
 };
 
 #endif
@@ -3,17 +3,19 @@
 #define CONTROLLER_H
 
 #include "flags.h"
+#include "cavity.h"
 #include <iostream>
 #include <unordered_map>
+#include <atomic>
 #include <wx/wx.h>
 
 struct CalcReportBundle;
 class Model;
 class MainFrame;
-class AtomTree;
+class AtomIndex;
 struct Atom;
 
-template <typename> class Container3D;
+#include "container3d.h"
 class Voxel;
 
 class Ctrl{
@@ -35,7 +37,9 @@ class Ctrl{
     bool runCalculation();
     bool runCalculation(const double, const double, const double, const std::string&,
         const std::string&, const std::string&, const int, const bool, const bool,
-        const bool, const bool, const bool, const bool, const bool, const unsigned);
+        const bool, const bool, const bool, const bool, const bool, const unsigned,
+        const unsigned=1, const bool=false, const unsigned long=0, const bool=false, const bool=false,
+        const mvINDEX=mvINDEX_AUTO, const mvPRECISION=mvPRECISION_DOUBLE);
     void registerView(MainFrame* inp_gui);
     void clearOutput();
     void notifyUser(std::string);
@@ -48,8 +52,9 @@ class Ctrl{
     void exportSurfaceMap(bool);
     void exportSurfaceMap(const std::string, bool);
     void renderSurface(const Container3D<Voxel>&, const std::array<double,3>, 
-        const double, const bool, const unsigned char, const std::vector<Atom>&);
+        const double, const bool, const size_t, const std::vector<Atom>&);
     const Container3D<Voxel>& getSurfaceData() const;
+    CavityID getCavityID(const std::array<unsigned,3>&) const;
 
     void newCalculation();
     void calculationDone(const bool=true);
@@ -67,7 +72,7 @@ class Ctrl{
     static Ctrl* s_instance;
     static MainFrame* s_gui;
 
-    bool _abort_calculation; // variable for main thread to signal stopping the calculation
+    std::atomic<bool> _abort_calculation; // variable for main thread to signal stopping the calculation
     bool _calculation_finished;
     bool _to_gui = true; // determines whether to print to console or to GUI
     bool _quiet = true; // silences all non-result command line outputs
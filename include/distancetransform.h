@@ -0,0 +1,49 @@
+#ifndef DISTANCETRANSFORM_H
+
+#define DISTANCETRANSFORM_H
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+class ThreadPool;
+
+// Exact squared Euclidean distance transform of a box of voxels. After the transform, every voxel
+// holds the squared distance, in units of voxels, to the closest feature voxel. The transform is
+// separated into one-dimensional transforms along x, y and z, each of which computes the lower
+// envelope of parabolas in linear time (Felzenszwalb & Huttenlocher, 2012). Therefore, the runtime
+// only depends on the number of voxels and not on the distances. Distances above a limit are not
+// resolved and are stored as limit+1.
+class DistanceTransform{
+  public:
+    typedef uint32_t value_type;
+
+    DistanceTransform() = default;
+    // box of voxels without features and the largest squared distance that is resolved
+    DistanceTransform(const std::array<unsigned,3>&, const value_type);
+
+    const std::array<unsigned,3>& getSize() const {return _size;}
+    value_type getLimit() const {return _limit;}
+    static size_t estimateMemory(const size_t n_voxels){return n_voxels * sizeof(value_type);}
+
+    // must be called before the transform. voxels can be set concurrently by multiple threads
+    void setFeature(const std::array<unsigned,3>& index){_values[calcIndex(index)] = 0;}
+    void compute(const ThreadPool&);
+
+    // squared distance to the closest feature voxel, or limit+1 if it exceeds the limit
+    value_type getValue(const std::array<unsigned,3>& index) const {return _values[calcIndex(index)];}
+    bool isFeature(const std::array<unsigned,3>& index) const {return getValue(index) == 0;}
+
+  private:
+    std::array<unsigned,3> _size = {0,0,0};
+    value_type _limit = 0;
+    std::vector<value_type> _values;
+
+    size_t calcIndex(const std::array<unsigned,3>& index) const {
+      return (size_t(index[2]) * _size[1] + index[1]) * _size[0] + index[0];
+    }
+    void transformAlongAxis(const ThreadPool&, const char);
+};
+
+#endif
@@ -55,6 +55,29 @@ enum mvTYPE : unsigned char {
   mvTYPE_ALL = 0b11111111
 };
 
+// relations between a voxel and an atom. a higher bit takes precedence over the lower bits, when
+// the relations to several atoms are combined
+enum mvREL : unsigned char {
+  mvREL_NONE = 0,
+  mvREL_TOUCH = 1 << 0, // probe cores that touch the atom may overlap with the voxel
+  mvREL_SHELL = 1 << 1, // the voxel is within probe reach of the atom, but outside of it
+  mvREL_PARTIAL = 1 << 2, // the voxel is partially inside the atom
+  mvREL_INSIDE = 1 << 3 // the voxel is completely inside the atom
+};
+
+// spatial index that is used to find the atoms close to a voxel
+enum mvINDEX : unsigned char {
+  mvINDEX_AUTO = 0,
+  mvINDEX_TREE,
+  mvINDEX_CELLS
+};
+
+// floating point precision in which voxels are classified against atoms
+enum mvPRECISION : unsigned char {
+  mvPRECISION_DOUBLE = 0,
+  mvPRECISION_SINGLE
+};
+
 enum mvFORMAT : unsigned char {
   mvFORMAT_STRING = 0,
   mvFORMAT_NUMBER,
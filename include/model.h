@@ -3,7 +3,7 @@
 #define MODEL_H
 
 // class for dealing with program logic
-#include "atomtree.h"
+#include "atomindex.h"
 #include "space.h"
 #include "cavity.h"
 #include "importmanager.h"
@@ -13,6 +13,17 @@
 #include <unordered_map>
 #include <math.h>
 
+// resources of a calculation, which are predicted before the grid is allocated (model_preflight.cpp)
+struct CalcEstimate{
+  int max_depth = 0;
+  // number of voxels per octree level, starting from the bottom level. stored voxels occupy memory
+  // and evaluated voxels have their type assigned
+  std::vector<double> n_vxl_stored;
+  std::vector<double> n_vxl_evaluated;
+  size_t grid_bytes = 0;
+  double runtime = 0; // in seconds
+};
+
 struct CalcReportBundle{
   // calculation returned without error
   bool success;
@@ -26,6 +37,15 @@ struct CalcReportBundle{
   // parameters for calculation
   double grid_step;
   int max_depth;
+  unsigned n_threads = 1;
+  bool sparse_octree = false;
+  unsigned long memory_budget = 0; // in MB, 0 keeps the whole grid in memory
+  size_t n_slabs = 1; // number of slabs that the grid has been divided into to fit into the memory budget
+  bool auto_depth = false; // option to choose the max depth with the lowest predicted runtime
+  bool distance_transform = false; // option to assign the probe shells with a distance transform
+  mvINDEX atom_index = mvINDEX_AUTO; // spatial index used to find the atoms close to a voxel
+  mvPRECISION precision = mvPRECISION_DOUBLE; // precision in which voxels are classified against atoms
+  CalcEstimate estimate;
   double r_probe1;
   double r_probe2;
   std::vector<std::string> included_elements;
@@ -51,11 +71,13 @@ struct CalcReportBundle{
   double getSurfProbeAccessible(){return surf_probe_accessible;}
   // cavity volumes and surfaces
   std::vector<Cavity> cavities;
-  double getCavVolume(const unsigned char i){return cavities[i].getVolume();}
-  std::array<double,3> getCavCentre(const unsigned char);
-  std::array<double,3> getCavCenter(const unsigned char i){return getCavCentre(i);}
-  double getCavSurfCore(const unsigned char i) const {return cavities[i].getSurfCore();}
-  double getCavSurfShell(const unsigned char i) const {return cavities[i].getSurfShell();}
+  double getCavVolume(const size_t i){return cavities[i].getVolume();}
+  std::array<double,3> getCavCentre(const size_t);
+  std::array<double,3> getCavCenter(const size_t i){return getCavCentre(i);}
+  double getCavSurfCore(const size_t i) const {return cavities[i].getSurfCore();}
+  double getCavSurfShell(const size_t i) const {return cavities[i].getSurfShell();}
+  // set if some voxels could not be assigned to their cavity
+  bool cavities_exceeded = false;
   // time
   std::vector<double> elapsed_seconds;
   void addTime(const double t){elapsed_seconds.push_back(t);}
@@ -65,7 +87,7 @@ struct CalcReportBundle{
 
 namespace ImportMngr{struct UnitCell;}
 
-class AtomTree;
+class AtomIndex;
 struct Atom;
 class Space;
 class Model{
@@ -93,7 +115,7 @@ class Model{
     void writeCavitiesMaps(const std::string);
     void writeSurfaceMap(const std::string, double, std::array<unsigned long int,3>, 
         std::array<double,3>, std::array<unsigned int,3>, std::array<unsigned int,3>, 
-        const bool=false, const unsigned char=0);
+        const bool=false, const size_t=0);
 
     std::vector<std::string> listElementsInStructure();
 
@@ -108,8 +130,9 @@ class Model{
     CalcReportBundle generateVolumeData();
     CalcReportBundle generateSurfaceData();
     const Container3D<Voxel>& getSurfaceData() const;
+    CavityID getCavityID(const std::array<unsigned,3>&) const;
     std::array<double,3> getCellOrigin() const;
-    const AtomTree& getAtomTree() const;
+    const AtomIndex& getAtomIndex() const;
 
     // calls the Space constructor and creates a cell containing all atoms. Cell size is defined by atom positions
     void defineCell();
@@ -124,6 +147,13 @@ class Model{
     void setRadiusMap(std::unordered_map<std::string, double> map);
     std::unordered_map<std::string,double> getRadiusMap();
     bool setProbeRadii(const double, const double, const bool);
+    void setNumThreads(const unsigned);
+    void setSparseOctree(const bool);
+    void setMemoryBudget(const unsigned long);
+    void setAutoDepth(const bool);
+    void setDistanceTransform(const bool);
+    void setAtomIndex(const mvINDEX);
+    void setPrecision(const mvPRECISION);
 
     // access functions for information stored in data
     double getCalcTime(){return _data.getTime();}
@@ -157,6 +187,28 @@ class Model{
     double _max_atom_radius = 0;
 
     void prepareVolumeCalc();
+
+    // prediction of memory usage and runtime before the grid is allocated (model_preflight.cpp)
+    std::array<double,3> estimateExposedAreas() const;
+    CalcEstimate estimateCalculation(const std::array<double,3>&) const;
+    void selectDepth(const std::array<double,3>&);
+    void reportEstimate(const CalcEstimate&) const;
+
+    // slab decomposition of grids that exceed the memory budget (model_slabs.cpp)
+    struct Slab{
+      // ranges of top level voxels along x, see Space
+      std::array<unsigned long,2> box;
+      std::array<unsigned long,2> labelled;
+      std::array<unsigned long,2> interior;
+      // maps the cavity IDs of the slab to the cavity IDs in the whole grid
+      std::vector<CavityID> stitched_ids;
+    };
+    std::vector<Slab> _slabs;
+    bool planSlabs();
+    std::vector<Atom> listAtomsNearSlab(const Slab&) const;
+    void calcSlabVolumes();
+    void stitchSlabCavities(const std::vector<std::vector<Cavity>>&, const std::vector<SlabLabels>&);
+    void calcSlabSurfaces(const std::vector<std::vector<char>>&);
     std::map<std::string, int> atomCount(const RawAtomData&);
     std::map<std::string, int> atomCount(const std::vector<Atom>&);
 
@@ -33,7 +33,7 @@ class wxScrollEvent;
 class wxButton;
 class wxListCtrl;
 
-template <typename> class Container3D;
+#include "container3d.h"
 class Voxel;
 class MainFrame;
 struct Atom;
@@ -45,7 +45,7 @@ class RenderFrame : public wxFrame {
 
     void OnClose(wxCloseEvent& event);
     void UpdateSurface(const Container3D<Voxel>&, const std::array<double,3>, 
-        const double, const bool, const unsigned char);
+        const double, const bool, const size_t);
     void UpdateMolecule(const std::vector<Atom>&);
     void Render();
   
@@ -5,17 +5,82 @@
 #include "voxel.h"
 #include "container3d.h"
 #include "cavity.h"
+#include "threadpool.h"
+#include "sparseoctree.h"
+#include "bitplane.h"
+#include "distancetransform.h"
 #include <vector>
 #include <array>
 #include <map>
+#include <utility>
+
+// the layout of the dense grids is chosen at compile time
+#ifdef MOLOVOL_MORTON_LAYOUT
+typedef MortonLayout GridLayout;
+#else
+typedef RowMajorLayout GridLayout;
+#endif
+
+// a pure core voxel in the region where two neighbouring slabs of the grid overlap, together with
+// its labels in one of the slabs. the voxel is identified by its first bottom level voxel
+struct SeamVoxel{
+  std::array<unsigned,3> index; // bottom level index in the whole grid
+  CavityID cavity;
+  CavityID entrance; // 0 if the voxel is not part of a cavity entrance
+};
+
+// information that is needed to join the cavities of a slab of the grid with those of the
+// neighbouring slabs. the labels of a slab are the IDs that it assigns to its cavities and entrances
+struct SlabLabels{
+  struct Entrance{
+    CavityID cavity;
+    bool interior; // the entrance has at least one voxel in the interior of the slab
+  };
+  // input: seam voxels shared with the previous slab, labelled in the previous slab
+  std::vector<SeamVoxel> lower_seam;
+  // output: seam voxels shared with the next slab, labelled in this slab
+  std::vector<SeamVoxel> upper_seam;
+  // output: pairs of labels in the previous slab and in this slab that belong to the same cavity or entrance
+  std::vector<std::pair<CavityID,CavityID>> cavity_links;
+  std::vector<std::pair<CavityID,CavityID>> entrance_links;
+  // output: the entrance with label i is stored at position i-1
+  std::vector<Entrance> entrances;
+  // output: the cavities with a voxel in the interior of the slab have the labels 1 to n
+  CavityID n_interior_cavities = 0;
+};
+
+// surface areas of several sets of solid types, which are calculated in a single pass through the
+// grid. for the cavity sets, the surface of every cavity is calculated from the voxels of the set
+// that have the cavity's ID
+struct SurfaceAreas{
+  std::vector<double> total; // by set
+  std::vector<std::vector<double>> cavities; // by cavity set, then by cavity ID
+};
 
 struct Atom;
 class Voxel;
+class SurfaceLUT {
+  private:
+    static const std::array<unsigned char,256> types_by_config;
+    static const std::array<double, 15> area_by_type;
+  public:
+    // number of marching cubes of each type
+    typedef std::array<unsigned long,15> TypeCounts;
+    static unsigned char configToType(unsigned char config);
+    static double typeToArea(unsigned char type);
+    static double configToArea(unsigned char config);
+    static double countsToArea(const TypeCounts&);
+};
+
 class Space{
   public:
     // constructors
     Space() = default;
-    Space(std::vector<Atom>&, const double, const int, const double, const bool, const std::array<double,3>);
+    Space(std::vector<Atom>&, const double, const int, const double, const bool, const std::array<double,3>, const bool=false, const bool=true);
+    // slab of a space, whose grid does not need to be allocated. the ranges are given in top level
+    // voxels along x in the parent space: the box of the slab, the range in which core voxels are
+    // assigned to cavities and the interior, which is the range that the results of the slab belong to
+    Space(const Space&, const std::array<unsigned long,2>&, const std::array<unsigned long,2>&, const std::array<unsigned long,2>&);
 
     // access
     std::array<double,3> getMin() const;
@@ -26,12 +91,18 @@ class Space{
     bool isInBounds(const std::array<unsigned,3>&, const unsigned);
     double getVxlSize() const;
     const Container3D<Voxel>& getGrid(const unsigned) const;
+    bool isSparse() const;
+    void allocateGrid();
+    size_t estimateGridMemory(const unsigned long) const;
+    size_t estimateSparseMemory(const size_t) const;
+    void allocateSubvoxels(const std::array<unsigned,3>&, const int, const Voxel&);
 
     // get voxel
     Voxel& getVxlFromGrid(const unsigned int, unsigned);
     Voxel& getVxlFromGrid(const unsigned int, const unsigned int, const unsigned int, unsigned);
     Voxel& getVxlFromGrid(const std::array<unsigned int,3>, unsigned);
     Voxel& getVxlFromGrid(const std::array<int,3>, unsigned);
+    const Voxel& getVxlFromGrid(const std::array<unsigned int,3>, unsigned) const;
     Voxel& getTopVxl(const unsigned int);
     Voxel& getTopVxl(const unsigned int, const unsigned int, const unsigned int);
     Voxel& getTopVxl(const std::array<unsigned int,3>);
@@ -39,24 +110,49 @@ class Space{
     const std::array<unsigned long,3> getGridsteps();
     std::array<std::array<unsigned int,3>,2> getUnitCellIndexes();
     unsigned long int totalVxlOnLvl(const int) const;
+    template <typename T = unsigned long>
+    const std::array<T,3> getGridstepsOnLvl(const int lvl) const {
+      std::array<T,3> gridsteps;
+      for (char dim = 0; dim < 3; ++dim){
+        gridsteps[dim] = static_cast<T>(_n_top_lvl_vxl[dim] << (_max_depth-lvl));
+      }
+      return gridsteps;
+    }
 
     int getMaxDepth(){return _max_depth;}
+    void setNumThreads(const unsigned);
+    unsigned getNumThreads() const;
+    void setDistanceTransform(const bool);
+    void setAtomIndex(const mvINDEX);
+    void setPrecision(const mvPRECISION);
     // output
     void printGrid();
 
     // type evaluation
     void assignTypeInGrid(std::vector<Atom>&, std::vector<Cavity>&, const double, const double, bool, bool&);
     void sumVolume(std::map<char,double>&, std::vector<Cavity>&, const bool);
+
+    // cavity IDs
+    CavityID getCavityID(const std::array<unsigned,3>&, const int) const;
+    CavityID lookUpCavityID(const unsigned char, const std::array<unsigned,3>&, const int) const;
+    unsigned char findLocalID(const CavityID, const std::array<unsigned,3>&, const int);
+    void setStitchedCavityIDs(const std::vector<CavityID>&);
+
+    // slab decomposition
+    bool isSlab() const;
+    unsigned long getSlabOffset() const;
+    unsigned long calcSearchReach(const double) const;
+    SlabLabels& getSlabLabels();
     void setUnitCellIndexes();
 
     // surface area
-    double calcSurfArea(const std::vector<char>&);
-    double calcSurfArea(const std::vector<char>&, const unsigned char, std::array<unsigned int,3>, std::array<unsigned int,3>);
+    SurfaceAreas calcSurfAreas(const std::vector<std::vector<char>>&, const std::vector<size_t>&, const CavityID);
 
   private:
     std::array <double,3> _cart_min; // this is also the "origin" of the space
     std::array <double,3> _cart_max;
-    std::vector<Container3D<Voxel>> _grid;
+    std::vector<Container3D<Voxel,GridLayout>> _grid;
+    std::array<unsigned long,3> _n_top_lvl_vxl = {0,0,0};
     // bottom level voxels indexes for the start of the unit cell in x,y,z direction
     std::array<unsigned int,3> _unit_cell_start_index; 
     // bottom level voxels indexes for the end of the unit cell in x,y,z direction
@@ -67,34 +163,92 @@ class Space{
     int _max_depth; // for voxels
     std::array<double,3> _unit_cell_limits; // cartesian coordinates of the unit cell orthogonal axes
     bool _unit_cell; // option to analyze unit cell
+    bool _sparse = false; // option to store the octree sparsely instead of in dense grids
+    unsigned _n_threads = 1; // number of threads used for the type assignment
+    bool _distance_transform = false; // option to assign the probe shells with a distance transform
+    mvINDEX _atom_index = mvINDEX_AUTO; // spatial index used to find the atoms close to a voxel
+    mvPRECISION _precision = mvPRECISION_DOUBLE; // precision in which voxels are classified against atoms
+    SparseOctree _sparse_grid;
+    // row-major copy of one level of the sparse octree or of a grid with a different layout
+    mutable Container3D<Voxel> _expanded_grid;
+    mutable int _expanded_lvl = -1;
+    // the grid is divided into blocks, each corresponding to one voxel on the palette level.
+    // voxels store the local ID of their cavity, which is an index into the palette of their
+    // block. this allows any number of cavities, while a voxel only needs one byte for the ID
+    struct IDPalette{
+      std::vector<CavityID> ids;
+      bool overflow = false; // set if a cavity ID did not fit into the palette
+    };
+    std::vector<IDPalette> _id_palettes;
+    std::array<unsigned long,3> _n_palette_blocks = {0,0,0};
+    int _palette_lvl = 0;
+    // maps the cavity IDs of a slab to the cavity IDs in the whole grid, unused if empty
+    std::vector<CavityID> _stitched_ids;
+    // a slab is a box of the grid that spans the whole grid along y and z. all ranges are in top
+    // level voxels along x, relative to the start of the slab
+    bool _slab = false;
+    std::array<double,3> _grid_origin; // origin of the whole grid, which is used for the voxel positions
+    unsigned long _slab_offset = 0; // start of the slab in the whole grid
+    bool _slab_at_grid_end = false;
+    unsigned long _slab_search_reach = 0; // largest search range of the probes so far
+    std::array<unsigned long,2> _labelled_top_x = {0,0};
+    std::array<unsigned long,2> _interior_top_x = {0,0};
+    SlabLabels _slab_labels;
 
     void setBoundaries(const std::vector<Atom>&, const double);
+    size_t calcPaletteIndex(const std::array<unsigned,3>&, const int) const;
+    bool isInSlabRange(const VoxelLoc&, const std::array<unsigned long,2>&) const;
+    VoxelLoc findLeaf(const std::array<unsigned,3>&);
+    const Voxel& findPureVxl(const std::array<unsigned,3>&, const int) const;
+    template<typename Visit>
+    void forEachPureVxl(const std::array<unsigned,3>&, const std::array<unsigned,3>&, Visit) const;
+    template<typename Visit>
+    void visitPureVxls(const std::array<unsigned,3>&, const int, const std::array<unsigned,3>&, const std::array<unsigned,3>&, Visit&) const;
+    void clampToInterior(std::array<unsigned,3>&, std::array<unsigned,3>&) const;
 
     void initGrid();
-    
-    template <typename T = unsigned long>
-    const std::array<T,3> getGridstepsOnLvl(const int lvl) const {
-      return _grid[lvl].getNumElements<T>();
-    }
 
+    static ThreadPool::progress_type makeProgressReporter(const size_t);
+
+    template<bool t_masking_mode>
     void assignAtomVsCore();
     void identifyCavities(std::vector<Cavity>&, const bool=false);
-    void descendToCore(std::vector<Cavity>&, unsigned char&, const std::array<unsigned,3>, int, const bool);
+    void listCoreVoxels(std::vector<VoxelLoc>&, const std::array<unsigned,3>&, const int);
+    std::array<unsigned,3> calcTopIndex(const size_t);
+    size_t calcTopPosition(const VoxelLoc&);
+    unsigned long long calcScanKey(const VoxelLoc&) const;
+    template<bool t_masking_mode>
     void assignShellVsVoid();
+    // shell vs void with a distance transform instead of the neighbour search (space_distance.cpp)
+    template<bool t_masking_mode>
+    void assignShellVsVoidByDistance(const std::array<unsigned long,2>&);
+    CavityID findClosestCoreID(const DistanceTransform&, const std::array<unsigned,3>&);
+    unsigned long calcTileSize() const;
+
+    // the sets of solid types of a surface calculation. bit s of the mask of a voxel type is set, if
+    // the type belongs to set s. the cavity mask flags the cavity sets, whose surfaces are calculated
+    // for the cavities up to the largest ID
+    struct SolidSets{
+      std::array<unsigned char,256> mask_by_type;
+      size_t n_sets;
+      std::vector<size_t> cavity_sets;
+      unsigned char cavity_mask;
+      CavityID max_id;
+    };
+    // cavity IDs of the voxels in a plane along z. the steps flag the voxels whose ID differs from
+    // that of their neighbour along +x, +y and -z, packed into words as in a BitPlane
+    struct CavityLayer{
+      std::vector<CavityID> ids;
+      std::array<std::vector<BitPlane::word_type>,3> steps;
+    };
+    static SolidSets makeSolidSets(const std::vector<std::vector<char>>&, const std::vector<size_t>&, const CavityID);
+    SurfaceAreas tallySurfaces(const SolidSets&, const std::array<unsigned,3>&, const std::array<unsigned,3>&);
+    void tallyRowSurface(const BitPlane&, const unsigned, const unsigned, SurfaceLUT::TypeCounts&) const;
+    void readSurfacePlane(const SolidSets&, const unsigned, const CavityLayer&, std::vector<BitPlane>&, CavityLayer&) const;
+    void flagCavitySteps(const SolidSets&, const std::vector<BitPlane>&, const unsigned, const CavityLayer&, CavityLayer&) const;
+    void tallyRowCavitySurfaces(const SolidSets&, const std::vector<BitPlane>&, const std::array<CavityLayer,2>&, const unsigned, const unsigned, std::vector<std::vector<SurfaceLUT::TypeCounts>>&) const;
+    void addCubeSurfaces(const std::array<unsigned,3>&, const double, const SolidSets&, SurfaceAreas&) const;
 
-    double tallySurface(const std::vector<char>&, std::array<unsigned int,3>&, std::array<unsigned int,3>&, const unsigned char=0, const bool=false);
-    unsigned char evalMarchingCubeConfig(const std::array<unsigned int,3>&, const std::vector<char>&, const unsigned char, const bool);
-
-};
-
-class SurfaceLUT {
-  private:
-    static const std::array<unsigned char,256> types_by_config;
-    static const std::array<double, 15> area_by_type;
-  public:
-    static unsigned char configToType(unsigned char config);
-    static double typeToArea(unsigned char type);
-    static double configToArea(unsigned char config);
 };
 
 #endif
@@ -0,0 +1,88 @@
+#ifndef SPARSEOCTREE_H
+
+#define SPARSEOCTREE_H
+
+#include "voxel.h"
+#include "container3d.h"
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// Stores the voxels of an octree sparsely. Only the top level voxels are stored in a dense grid.
+// When a voxel is split, its 8 subvoxels are allocated as one block from the pool of the top
+// level voxel they belong to. Voxels below a voxel that has not been split are not stored. They
+// have the same type and ID as their closest stored ancestor, which is returned in their place.
+// Therefore, the memory usage scales with the number of split voxels, i.e., with the surface
+// area of the structure, rather than with the volume of the grid.
+class SparseOctree{
+  public:
+    SparseOctree() = default;
+    SparseOctree(const std::array<unsigned long,3>&, const int);
+    // blocks are linked by pointers, which would refer to the original in a copy
+    SparseOctree(const SparseOctree&) = delete;
+    SparseOctree& operator=(const SparseOctree&) = delete;
+    SparseOctree(SparseOctree&&) = default;
+    SparseOctree& operator=(SparseOctree&&) = default;
+
+    Voxel& getElement(const std::array<unsigned,3>&, const int);
+    const Voxel& getElement(const std::array<unsigned,3>&, const int) const;
+    void allocateSubvoxels(const std::array<unsigned,3>&, const int, const Voxel&);
+    // memory for a number of top level voxels and split voxels
+    static size_t estimateMemory(const size_t, const size_t);
+
+  private:
+    struct Block{
+      Block() = default;
+      Block(const Voxel&);
+      std::array<Voxel,8> subvoxels;
+      // blocks containing the subvoxels of each subvoxel. null if the subvoxel has not been split
+      std::array<Block*,8> children = {};
+    };
+
+    // top level voxel and the pool of blocks for all its subvoxels. the blocks are stored in
+    // chunks of increasing size. a chunk is never reallocated, so that pointers and references
+    // to blocks remain valid while new blocks are added
+    struct TopVoxel{
+      Voxel vxl;
+      Block* children = nullptr;
+      std::vector<std::vector<Block>> chunks;
+      size_t n_blocks = 0;
+
+      Block* allocate(const Block&);
+    };
+
+    Container3D<TopVoxel> _top_lvl;
+    int _max_depth = 0;
+
+    static char calcOctant(const std::array<unsigned,3>&, const int);
+};
+
+// returns the voxel at the index on the level lvl. if the voxel is not stored, its closest stored
+// ancestor is returned instead. defined here, since it is called very often
+inline const Voxel& SparseOctree::getElement(const std::array<unsigned,3>& index, const int lvl) const {
+  const int n_lvl_below_top = _max_depth - lvl;
+  const TopVoxel& top = _top_lvl.getElement(
+      index[0] >> n_lvl_below_top, index[1] >> n_lvl_below_top, index[2] >> n_lvl_below_top);
+  if (n_lvl_below_top == 0 || !top.vxl.hasSubvoxel()){return top.vxl;}
+
+  const Block* block = top.children;
+  for (int shift = n_lvl_below_top-1; ; --shift){
+    const char octant = calcOctant(index, shift);
+    const Voxel& vxl = block->subvoxels[octant];
+    if (shift == 0 || !vxl.hasSubvoxel()){return vxl;}
+    block = block->children[octant];
+  }
+}
+
+inline Voxel& SparseOctree::getElement(const std::array<unsigned,3>& index, const int lvl){
+  return const_cast<Voxel&>(std::as_const(*this).getElement(index, lvl));
+}
+
+// position of a subvoxel inside its block. shift is the number of levels between the subvoxel
+// and the voxel that the index refers to
+inline char SparseOctree::calcOctant(const std::array<unsigned,3>& index, const int shift){
+  return (((index[0] >> shift) & 1) << 2) | (((index[1] >> shift) & 1) << 1) | ((index[2] >> shift) & 1);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef THREADPOOL_H
+
+#define THREADPOOL_H
+
+#include <functional>
+#include <vector>
+#include <cstddef>
+
+// Distributes the iterations [0,n) of a loop among a number of threads. Every thread
+// begins with a contiguous share of the iterations and works through it from the front.
+// A thread that runs out of work steals the back half of the largest remaining share of
+// another thread. This balances the load, even when the cost of iterations varies by
+// orders of magnitude (e.g. voxels at the molecular surface vs. empty voxels).
+// The calling thread takes part in the work as thread 0 and is the only thread that
+// executes the progress callback, which makes it safe to communicate with the GUI there.
+class ThreadPool{
+  public:
+    typedef std::function<void(const size_t, const unsigned)> task_type;
+    typedef std::function<void(const size_t)> progress_type;
+
+    ThreadPool(const unsigned);
+
+    unsigned getNumThreads() const;
+    // runs task(i, thread_id) for every i in [0,n). the progress callback receives the
+    // number of completed iterations
+    void parallelFor(const size_t, const task_type&, const progress_type& = nullptr) const;
+
+    static unsigned validateNumThreads(const unsigned);
+  private:
+    unsigned _n_threads;
+};
+
+#endif
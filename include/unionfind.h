@@ -0,0 +1,27 @@
+#ifndef UNIONFIND_H
+
+#define UNIONFIND_H
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+// Disjoint set forest over the elements [0,n) that can be merged concurrently by multiple
+// threads without locks. Sets are always linked such that the root of a set is its
+// smallest element. Therefore, the resulting roots only depend on which elements have
+// been merged and not on the order in which the merges happened.
+class UnionFind{
+  public:
+    UnionFind(const size_t);
+
+    size_t size() const;
+    // returns the smallest element of the set containing the element
+    size_t find(size_t);
+    // merges the sets containing the two elements
+    void unite(size_t, size_t);
+    bool isRoot(const size_t) const;
+  private:
+    std::vector<std::atomic<size_t>> _parent;
+};
+
+#endif
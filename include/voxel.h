@@ -3,7 +3,7 @@
 #define VOXEL_H
 
 #include "vector.h"
-#include "atomtree.h"
+#include "atomindex.h"
 #include "container3d.h"
 #include "flags.h"
 #include "cavity.h"
@@ -16,6 +16,7 @@ struct SearchIndex{
   public:
     SearchIndex();
     SearchIndex(const double, const double, const unsigned int);
+    static unsigned int calcUppLim(const double, const double, const unsigned int);
     const std::vector<std::array<int,3>>& operator[](unsigned int);
     unsigned int getUppLim(unsigned int);
     unsigned int getSafeLim(unsigned int);
@@ -27,10 +28,36 @@ struct SearchIndex{
     std::vector<unsigned> _safe_lim;
 };
 
+// location of a voxel in the octree
+struct VoxelLoc{
+  VoxelLoc() = default;
+  VoxelLoc(const std::array<unsigned,3>& index, const int lvl) : index(index), lvl(lvl) {}
+  std::array<unsigned,3> index;
+  int lvl;
+};
+
+// range of atoms on the per-thread candidate stack (see Voxel::s_candidates)
+struct AtomCandidates{
+  size_t offset;
+  size_t n;
+};
+
+// types that the passes of the type assignment give to voxels with the small probe and, in masking
+// mode, with the large probe. the passes are instantiated for both modes, so that the types are
+// known at compile time
+template<bool t_masking_mode>
+struct ProbeTypes{
+  static constexpr unsigned char core = t_masking_mode? 0b00100001 : 0b00001001;
+  static constexpr unsigned char shell = t_masking_mode? 0b01000001 : 0b00010001;
+  static constexpr unsigned char excluded = t_masking_mode? 0b00000000 : 0b00000101;
+  // types of the first pass that are resolved by the search for probe cores
+  static constexpr unsigned char near_atom = t_masking_mode? 0b01000000 : 0b00010000;
+  static constexpr unsigned char touching_atom = t_masking_mode? 0b11000000 : 0b10010000;
+  static constexpr char core_bit = t_masking_mode? 5 : 3;
+};
+
 class Space;
-class FloodStack;
 struct Atom;
-struct VoxelLoc;
 class Voxel{
   public:
     Voxel();
@@ -39,49 +66,61 @@ class Voxel{
     Voxel& getSubvoxel(std::array<unsigned,3>, const unsigned, const char);
     Voxel& getSubvoxel(std::array<unsigned,3>, const unsigned);
     void setType(char);
-    char getType() const;
-    void setID(unsigned char);
-    unsigned char getID() const;
+    char getType() const {return _type;}
+    // the local ID identifies the cavity among the cavities in the same block of the grid. the
+    // cavity ID is looked up in the palette of the block by the Space (Space::lookUpCavityID)
+    void setLocalID(unsigned char);
+    unsigned char getLocalID() const;
 
     // bitwise operations on _type
-    bool hasSubvoxel(); // state of bit 7
-    bool isCore(); // state of bit 3
-    bool isAssigned(); // state of bit 0
+    bool hasSubvoxel() const {return _type & 0b10000000;} // state of bit 7
+    bool isCore() const; // state of bit 3
+    bool isAssigned() const; // state of bit 0
 
     // calc preparation
-    static void prepareTypeAssignment(Space*, std::vector<Atom>&);
-    static void storeProbe(const double, const bool);
+    static void prepareTypeAssignment(Space*, std::vector<Atom>&, const double, const mvINDEX = mvINDEX_AUTO, const mvPRECISION = mvPRECISION_DOUBLE);
+    static void storeProbe(const double);
     static void computeIndices();
     static void computeIndices(unsigned int);
+    static unsigned getSearchRange(const unsigned);
+    static double getProbeRadius(){return s_r_probe;}
 
     // atom vs probe core
-    char evalRelationToAtoms(const std::array<unsigned,3>&, Vector, const int);
-    void traverseTree(const AtomNode*, const double, const Vector&, const double, const double, const int,
-        const char = 0b00000011, const char = 0);
+    template<bool t_masking_mode>
+    char evalRelationToAtoms(const std::array<unsigned,3>&, Vector, const int, const AtomCandidates* = nullptr);
+    static unsigned long takeNodeVisits();
     void passTypeToChildren(const std::array<unsigned,3>&, const int);
-    void splitVoxel(const std::array<unsigned,3>&, const Vector&, const double);
+    template<bool t_masking_mode>
+    void splitVoxel(const std::array<unsigned,3>&, const Vector&, const int, const AtomCandidates*);
 
     // cavity id
-    bool floodFill(std::vector<Cavity>&, const unsigned char, const std::array<unsigned,3>&, const int, const bool=false);
+    void findCoreNeighbours(std::vector<VoxelLoc>&, const VoxelLoc&);
+    bool isInterfaceVxl(const VoxelLoc&);
 
     // shell vs void
+    template<bool t_masking_mode>
     char evalRelationToVoxels(const std::array<unsigned int,3>&, const unsigned, bool=false);
+    // shell vs void with a distance transform instead of the neighbour search (space_distance.cpp)
+    static unsigned getSqrSearchLim(const unsigned lvl){return s_search_indices.getUppLim(lvl);}
+    static const std::vector<std::array<int,3>>& getSearchShell(const unsigned n){return s_search_indices[n];}
+    template<bool t_masking_mode>
+    bool isProbeCore() const;
+    template<bool t_masking_mode>
+    void evalCoreDistance(const bool);
+    char mergeSubvoxels(const std::array<unsigned,3>&, const int);
 
     // volume
     void tallyVoxelsOfType(std::map<char,double>&,
-        std::map<unsigned char,double>&,
-        std::map<unsigned char,double>&,
-        std::map<unsigned char,std::array<unsigned,3>>&,
-        std::map<unsigned char,std::array<unsigned,3>>&,
+        std::map<CavityID,double>&,
+        std::map<CavityID,double>&,
+        std::map<CavityID,std::array<unsigned,3>>&,
+        std::map<CavityID,std::array<unsigned,3>>&,
         const std::array<unsigned,3>&,
         const int,
         const double=1);
 
-    // unused but could become useful
-    static void listFromTree(std::vector<int>&, const AtomNode*, const Vector&, 
-        const double&, const double&, const double&, const char=0);
-    static const AtomTree& getAtomTree() {
-      return *s_atomtree;
+    static const AtomIndex& getAtomIndex() {
+      return *s_atom_index;
     }
   private:
     char _type;
@@ -89,26 +128,46 @@ class Voxel{
 
     static inline Space* s_cell; // gets destroyed by Model
     // atom vs core
-    static inline AtomTree* s_atomtree;
+    static inline std::unique_ptr<AtomIndex> s_atom_index;
+    static inline mvPRECISION s_precision = mvPRECISION_DOUBLE;
+    static inline thread_local unsigned long s_n_node_visits = 0;
+    // atoms that may be related to the voxels of the current branch of the octree. every voxel
+    // that is split pushes its candidates and pops them when its children are done. the stack
+    // of the selected precision is used
+    static inline thread_local AtomKernel::Stack<double> s_candidates;
+    static inline thread_local AtomKernel::Stack<float> s_candidates_single;
+    template<typename T>
+    static AtomKernel::Stack<T>& getCandidates(){
+      if constexpr (std::is_same_v<T,float>){return s_candidates_single;}
+      else {return s_candidates;}
+    }
+    // geometry of the voxels on one level of the octree
+    struct LevelGeometry{
+      double rad_vxl; // radius of the sphere around the centres of the bottom level subvoxels
+      double sub_offset; // distance along each axis between the centre and the subvoxels' centres
+      double rad_select; // radius within which the candidate atoms of the subvoxels are selected
+    };
+    // computed for every probe, indexed by the level
+    static inline std::vector<LevelGeometry> s_lvl_geometry;
     // shell vs void
     static inline double s_r_probe;
-    static inline bool s_masking_mode;
     static inline SearchIndex s_search_indices;
 
-    static inline double calcVxlRadius(const double& max_depth);
+    static double calcVxlRadius(const int);
 
     // atom vs core
-    bool isAtom(const Atom&, const Vector&, const double, const double);
+    template<typename T>
+    static unsigned char classifyAtoms(const Vector&, const int, const AtomCandidates*, AtomCandidates&);
+    template<bool t_masking_mode>
+    void applyAtomRelations(const unsigned char);
     // cavity id
-    bool isInterfaceVxl(const VoxelLoc&);
-    std::vector<VoxelLoc> findPureNeighbours(const VoxelLoc&, const unsigned char=mvTYPE_ALL, const bool=false);
-    std::vector<VoxelLoc> findPureNeighbors(const VoxelLoc&, const unsigned char=mvTYPE_ALL, const bool=false);
+    void findPureNeighbours(std::vector<VoxelLoc>&, const VoxelLoc&, const unsigned char=mvTYPE_ALL, const bool=false);
     void descend(std::vector<VoxelLoc>&, const std::array<unsigned,3>&, 
         const int, const std::array<int,3>&, const unsigned char);
     void ascend(std::vector<VoxelLoc>&, const std::array<unsigned,3>, 
         const int, std::array<unsigned,3>, const std::array<int,3>&);
-    void passIDtoChildren(const std::array<unsigned,3>&, const int);
     // shell vs void
+    template<bool t_masking_mode>
     bool searchForCore(const std::array<unsigned int,3>&, const unsigned, bool=false);
 };
 
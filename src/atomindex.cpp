@@ -0,0 +1,21 @@
+#include "atomindex.h"
+#include "atomtree.h"
+#include "celllist.h"
+#include <algorithm>
+
+// smallest fraction of occupied cells, for which the cell list is chosen automatically. in
+// sparser structures, most cells in the range of a query are empty and the atom tree is faster
+static constexpr double s_min_occupancy = 0.2;
+
+// the cells are as large as the reach of the largest atom, so that a query for a small voxel
+// covers few cells
+std::unique_ptr<AtomIndex> AtomIndex::create(const std::vector<Atom>& atoms, const double r_probe, const mvINDEX type){
+  if (type == mvINDEX_TREE){return std::make_unique<AtomTree>(atoms);}
+  double max_rad = 0;
+  for (const Atom& atom : atoms){
+    max_rad = std::max(max_rad, atom.rad);
+  }
+  std::unique_ptr<CellList> cell_list = std::make_unique<CellList>(atoms, max_rad + std::max(r_probe, 0.0));
+  if (type == mvINDEX_CELLS || cell_list->getOccupancy() >= s_min_occupancy){return cell_list;}
+  return std::make_unique<AtomTree>(atoms);
+}
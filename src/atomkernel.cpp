@@ -0,0 +1,335 @@
+#include "atomkernel.h"
+#include "flags.h"
+#include <algorithm>
+
+// the vectorised implementations are compiled for their instruction sets with function attributes
+// and are only called, if the CPU supports them. the products must not be fused with the following
+// additions, since fused multiply-add rounds differently than the scalar implementation. fma is
+// not enabled for AVX2, but is part of AVX-512, so that the products are computed with an explicit
+// rounding mode there, which the compiler does not contract
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MV_ATOMKERNEL_X86
+#define MV_AVX2 __attribute__((target("avx2")))
+#define MV_AVX512 __attribute__((target("avx512f")))
+#include <immintrin.h>
+#endif
+
+namespace {
+  // selecting atoms is a template parameter, so that classifying without selecting does not pay
+  // for it. the selected atoms are those with sqr_dist < lim_select^2
+  template<typename T>
+  using Kernel = size_t (*)(const AtomKernel::Bucket<T>&, const size_t, const AtomKernel::Query<T>&, const T, const AtomKernel::Buffer<T>&, unsigned char&);
+
+  template<typename T, bool t_select>
+  size_t classifyScalar(const AtomKernel::Bucket<T>& bucket, const size_t n, const AtomKernel::Query<T>& query, const T rad_select, const AtomKernel::Buffer<T>& out, unsigned char& relations){
+    size_t n_selected = 0;
+    for (size_t i = 0; i < n; ++i){
+      const T dx = query.pos[0] - bucket.x[i];
+      const T dy = query.pos[1] - bucket.y[i];
+      const T dz = query.pos[2] - bucket.z[i];
+      const T sqr_dist = (dx*dx + dy*dy) + dz*dz;
+
+      const T lim_inside = bucket.rad[i] - query.rad_vxl;
+      const T lim_partial = bucket.rad[i] + query.rad_vxl;
+      const T lim_shell = (bucket.rad[i] + query.rad_probe) - query.rad_vxl;
+      const T lim_touch = (bucket.rad[i] + query.rad_probe) + query.rad_vxl;
+
+      if (sqr_dist < lim_inside*lim_inside && 0 < lim_inside){relations |= mvREL_INSIDE;}
+      if (sqr_dist < lim_partial*lim_partial){relations |= mvREL_PARTIAL;}
+      if (sqr_dist < lim_shell*lim_shell && 0 < lim_shell){relations |= mvREL_SHELL;}
+      if (sqr_dist < lim_touch*lim_touch){relations |= mvREL_TOUCH;}
+
+      if constexpr (t_select){
+        const T lim_select = (bucket.rad[i] + query.rad_probe) + rad_select;
+        if (sqr_dist < lim_select*lim_select){
+          out.x[n_selected] = bucket.x[i];
+          out.y[n_selected] = bucket.y[i];
+          out.z[n_selected] = bucket.z[i];
+          out.rad[n_selected] = bucket.rad[i];
+          ++n_selected;
+        }
+      }
+    }
+    return n_selected;
+  }
+
+#ifdef MV_ATOMKERNEL_X86
+  // operations on AVX2 registers of either precision. the lanes after the last atom are not
+  // loaded. comparisons return one bit per lane
+  template<typename T>
+  struct AVX2;
+
+  template<>
+  struct AVX2<double>{
+    typedef __m256d Vec;
+    static constexpr size_t s_width = 4;
+    MV_AVX2 static Vec set1(const double a){return _mm256_set1_pd(a);}
+    MV_AVX2 static Vec zero(){return _mm256_setzero_pd();}
+    MV_AVX2 static Vec load(const double* p, const size_t n_lanes){
+      return _mm256_maskload_pd(p, _mm256_cmpgt_epi64(_mm256_set1_epi64x(n_lanes), _mm256_setr_epi64x(0, 1, 2, 3)));
+    }
+    MV_AVX2 static Vec add(const Vec a, const Vec b){return _mm256_add_pd(a, b);}
+    MV_AVX2 static Vec sub(const Vec a, const Vec b){return _mm256_sub_pd(a, b);}
+    MV_AVX2 static Vec mul(const Vec a, const Vec b){return _mm256_mul_pd(a, b);}
+    MV_AVX2 static int lt(const Vec a, const Vec b){return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ));}
+  };
+
+  template<>
+  struct AVX2<float>{
+    typedef __m256 Vec;
+    static constexpr size_t s_width = 8;
+    MV_AVX2 static Vec set1(const float a){return _mm256_set1_ps(a);}
+    MV_AVX2 static Vec zero(){return _mm256_setzero_ps();}
+    MV_AVX2 static Vec load(const float* p, const size_t n_lanes){
+      return _mm256_maskload_ps(p, _mm256_cmpgt_epi32(_mm256_set1_epi32(n_lanes), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    }
+    MV_AVX2 static Vec add(const Vec a, const Vec b){return _mm256_add_ps(a, b);}
+    MV_AVX2 static Vec sub(const Vec a, const Vec b){return _mm256_sub_ps(a, b);}
+    MV_AVX2 static Vec mul(const Vec a, const Vec b){return _mm256_mul_ps(a, b);}
+    MV_AVX2 static int lt(const Vec a, const Vec b){return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ));}
+  };
+
+  // processes 4 atoms in double or 8 atoms in single precision per iteration. there is no
+  // compressing store in AVX2, so that the selected atoms are copied one by one
+  template<typename T, bool t_select>
+  MV_AVX2
+  size_t classifyAVX2(const AtomKernel::Bucket<T>& bucket, const size_t n, const AtomKernel::Query<T>& query, const T rad_select, const AtomKernel::Buffer<T>& out, unsigned char& relations){
+    typedef AVX2<T> V;
+    typedef typename V::Vec Vec;
+    const Vec vxl_x = V::set1(query.pos[0]);
+    const Vec vxl_y = V::set1(query.pos[1]);
+    const Vec vxl_z = V::set1(query.pos[2]);
+    const Vec rad_vxl = V::set1(query.rad_vxl);
+    const Vec rad_probe = V::set1(query.rad_probe);
+    const Vec rad_sel = V::set1(rad_select);
+    const Vec zero = V::zero();
+    int inside = 0, partial = 0, shell = 0, touch = 0;
+    size_t n_selected = 0;
+    for (size_t i = 0; i < n; i += V::s_width){
+      const size_t n_lanes = n - i < V::s_width? n - i : V::s_width;
+      const Vec dx = V::sub(vxl_x, V::load(bucket.x + i, n_lanes));
+      const Vec dy = V::sub(vxl_y, V::load(bucket.y + i, n_lanes));
+      const Vec dz = V::sub(vxl_z, V::load(bucket.z + i, n_lanes));
+      const Vec rad = V::load(bucket.rad + i, n_lanes);
+      const Vec sqr_dist = V::add(V::add(V::mul(dx, dx), V::mul(dy, dy)), V::mul(dz, dz));
+
+      const Vec lim_inside = V::sub(rad, rad_vxl);
+      const Vec lim_partial = V::add(rad, rad_vxl);
+      const Vec lim_shell = V::sub(V::add(rad, rad_probe), rad_vxl);
+      const Vec lim_touch = V::add(V::add(rad, rad_probe), rad_vxl);
+
+      const int lanes = (1 << n_lanes) - 1;
+      inside |= lanes & V::lt(sqr_dist, V::mul(lim_inside, lim_inside)) & V::lt(zero, lim_inside);
+      partial |= lanes & V::lt(sqr_dist, V::mul(lim_partial, lim_partial));
+      shell |= lanes & V::lt(sqr_dist, V::mul(lim_shell, lim_shell)) & V::lt(zero, lim_shell);
+      touch |= lanes & V::lt(sqr_dist, V::mul(lim_touch, lim_touch));
+
+      if constexpr (t_select){
+        const Vec lim_select = V::add(V::add(rad, rad_probe), rad_sel);
+        int selected = lanes & V::lt(sqr_dist, V::mul(lim_select, lim_select));
+        while (selected){
+          const size_t j = i + __builtin_ctz(selected);
+          out.x[n_selected] = bucket.x[j];
+          out.y[n_selected] = bucket.y[j];
+          out.z[n_selected] = bucket.z[j];
+          out.rad[n_selected] = bucket.rad[j];
+          ++n_selected;
+          selected &= selected - 1;
+        }
+      }
+    }
+    relations |= (inside? mvREL_INSIDE : 0) | (partial? mvREL_PARTIAL : 0) | (shell? mvREL_SHELL : 0) | (touch? mvREL_TOUCH : 0);
+    return n_selected;
+  }
+
+  // operations on AVX-512 registers of either precision. the lanes that are not set in the mask
+  // are neither loaded nor compared
+  template<typename T>
+  struct AVX512;
+
+  template<>
+  struct AVX512<double>{
+    typedef __m512d Vec;
+    typedef __mmask8 Mask;
+    static constexpr size_t s_width = 8;
+    MV_AVX512 static Vec set1(const double a){return _mm512_set1_pd(a);}
+    MV_AVX512 static Vec zero(){return _mm512_setzero_pd();}
+    MV_AVX512 static Vec load(const Mask m, const double* p){return _mm512_maskz_loadu_pd(m, p);}
+    MV_AVX512 static Vec add(const Vec a, const Vec b){return _mm512_add_pd(a, b);}
+    MV_AVX512 static Vec sub(const Vec a, const Vec b){return _mm512_sub_pd(a, b);}
+    MV_AVX512 static Vec mul(const Vec a, const Vec b){
+      return _mm512_maskz_mul_round_pd(0xFF, a, b, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    MV_AVX512 static Mask lt(const Mask m, const Vec a, const Vec b){return _mm512_mask_cmp_pd_mask(m, a, b, _CMP_LT_OQ);}
+    MV_AVX512 static void compress(double* p, const Mask m, const Vec a){_mm512_mask_compressstoreu_pd(p, m, a);}
+  };
+
+  template<>
+  struct AVX512<float>{
+    typedef __m512 Vec;
+    typedef __mmask16 Mask;
+    static constexpr size_t s_width = 16;
+    MV_AVX512 static Vec set1(const float a){return _mm512_set1_ps(a);}
+    MV_AVX512 static Vec zero(){return _mm512_setzero_ps();}
+    MV_AVX512 static Vec load(const Mask m, const float* p){return _mm512_maskz_loadu_ps(m, p);}
+    MV_AVX512 static Vec add(const Vec a, const Vec b){return _mm512_add_ps(a, b);}
+    MV_AVX512 static Vec sub(const Vec a, const Vec b){return _mm512_sub_ps(a, b);}
+    MV_AVX512 static Vec mul(const Vec a, const Vec b){
+      return _mm512_maskz_mul_round_ps(0xFFFF, a, b, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+    MV_AVX512 static Mask lt(const Mask m, const Vec a, const Vec b){return _mm512_mask_cmp_ps_mask(m, a, b, _CMP_LT_OQ);}
+    MV_AVX512 static void compress(float* p, const Mask m, const Vec a){_mm512_mask_compressstoreu_ps(p, m, a);}
+  };
+
+  // processes 8 atoms in double or 16 atoms in single precision per iteration. the selected atoms
+  // are written with a compressing store
+  template<typename T, bool t_select>
+  MV_AVX512
+  size_t classifyAVX512(const AtomKernel::Bucket<T>& bucket, const size_t n, const AtomKernel::Query<T>& query, const T rad_select, const AtomKernel::Buffer<T>& out, unsigned char& relations){
+    typedef AVX512<T> V;
+    typedef typename V::Vec Vec;
+    typedef typename V::Mask Mask;
+    const Vec vxl_x = V::set1(query.pos[0]);
+    const Vec vxl_y = V::set1(query.pos[1]);
+    const Vec vxl_z = V::set1(query.pos[2]);
+    const Vec rad_vxl = V::set1(query.rad_vxl);
+    const Vec rad_probe = V::set1(query.rad_probe);
+    const Vec rad_sel = V::set1(rad_select);
+    const Vec zero = V::zero();
+    Mask inside = 0, partial = 0, shell = 0, touch = 0;
+    size_t n_selected = 0;
+    for (size_t i = 0; i < n; i += V::s_width){
+      const Mask lanes = n - i < V::s_width? Mask((1u << (n - i)) - 1) : Mask(~0u);
+      const Vec x = V::load(lanes, bucket.x + i);
+      const Vec y = V::load(lanes, bucket.y + i);
+      const Vec z = V::load(lanes, bucket.z + i);
+      const Vec rad = V::load(lanes, bucket.rad + i);
+      const Vec dx = V::sub(vxl_x, x);
+      const Vec dy = V::sub(vxl_y, y);
+      const Vec dz = V::sub(vxl_z, z);
+      const Vec sqr_dist = V::add(V::add(V::mul(dx, dx), V::mul(dy, dy)), V::mul(dz, dz));
+
+      const Vec lim_inside = V::sub(rad, rad_vxl);
+      const Vec lim_partial = V::add(rad, rad_vxl);
+      const Vec lim_shell = V::sub(V::add(rad, rad_probe), rad_vxl);
+      const Vec lim_touch = V::add(V::add(rad, rad_probe), rad_vxl);
+
+      inside |= V::lt(V::lt(lanes, zero, lim_inside), sqr_dist, V::mul(lim_inside, lim_inside));
+      partial |= V::lt(lanes, sqr_dist, V::mul(lim_partial, lim_partial));
+      shell |= V::lt(V::lt(lanes, zero, lim_shell), sqr_dist, V::mul(lim_shell, lim_shell));
+      touch |= V::lt(lanes, sqr_dist, V::mul(lim_touch, lim_touch));
+
+      if constexpr (t_select){
+        const Vec lim_select = V::add(V::add(rad, rad_probe), rad_sel);
+        const Mask selected = V::lt(lanes, sqr_dist, V::mul(lim_select, lim_select));
+        V::compress(out.x + n_selected, selected, x);
+        V::compress(out.y + n_selected, selected, y);
+        V::compress(out.z + n_selected, selected, z);
+        V::compress(out.rad + n_selected, selected, rad);
+        n_selected += __builtin_popcount(selected);
+      }
+    }
+    relations |= (inside? mvREL_INSIDE : 0) | (partial? mvREL_PARTIAL : 0) | (shell? mvREL_SHELL : 0) | (touch? mvREL_TOUCH : 0);
+    return n_selected;
+  }
+#endif
+
+  template<typename T>
+  struct Kernels{
+    Kernel<T> classify;
+    Kernel<T> select;
+  };
+
+  template<typename T>
+  Kernels<T> selectKernels(){
+#ifdef MV_ATOMKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")){return {classifyAVX512<T,false>, classifyAVX512<T,true>};}
+    if (__builtin_cpu_supports("avx2")){return {classifyAVX2<T,false>, classifyAVX2<T,true>};}
+#endif
+    return {classifyScalar<T,false>, classifyScalar<T,true>};
+  }
+
+  template<typename T>
+  const Kernels<T> s_kernels = selectKernels<T>();
+}
+
+// the comparisons are the same in all implementations. the limits of the inside and the shell
+// relation are only valid, if they are positive
+template<typename T>
+unsigned char AtomKernel::classifyScalar(const Bucket<T>& bucket, const size_t n, const Query<T>& query){
+  unsigned char relations = mvREL_NONE;
+  ::classifyScalar<T,false>(bucket, n, query, 0, {}, relations);
+  return relations;
+}
+
+template<typename T>
+unsigned char AtomKernel::classify(const Bucket<T>& bucket, const size_t n, const Query<T>& query){
+  unsigned char relations = mvREL_NONE;
+  s_kernels<T>.classify(bucket, n, query, 0, {}, relations);
+  return relations;
+}
+
+// the buffer must have room for n atoms
+template<typename T>
+size_t AtomKernel::classifyAndSelectScalar(const Bucket<T>& bucket, const size_t n, const Query<T>& query, const T rad_select, const Buffer<T>& out, unsigned char& relations){
+  return ::classifyScalar<T,true>(bucket, n, query, rad_select, out, relations);
+}
+
+template<typename T>
+size_t AtomKernel::classifyAndSelect(const Bucket<T>& bucket, const size_t n, const Query<T>& query, const T rad_select, const Buffer<T>& out, unsigned char& relations){
+  return s_kernels<T>.select(bucket, n, query, rad_select, out, relations);
+}
+
+template unsigned char AtomKernel::classifyScalar(const Bucket<double>&, const size_t, const Query<double>&);
+template unsigned char AtomKernel::classifyScalar(const Bucket<float>&, const size_t, const Query<float>&);
+template unsigned char AtomKernel::classify(const Bucket<double>&, const size_t, const Query<double>&);
+template unsigned char AtomKernel::classify(const Bucket<float>&, const size_t, const Query<float>&);
+template size_t AtomKernel::classifyAndSelectScalar(const Bucket<double>&, const size_t, const Query<double>&, const double, const Buffer<double>&, unsigned char&);
+template size_t AtomKernel::classifyAndSelectScalar(const Bucket<float>&, const size_t, const Query<float>&, const float, const Buffer<float>&, unsigned char&);
+template size_t AtomKernel::classifyAndSelect(const Bucket<double>&, const size_t, const Query<double>&, const double, const Buffer<double>&, unsigned char&);
+template size_t AtomKernel::classifyAndSelect(const Bucket<float>&, const size_t, const Query<float>&, const float, const Buffer<float>&, unsigned char&);
+
+void AtomKernel::AtomArrays::reserve(const size_t n){
+  for (std::vector<double>* array : {&_x, &_y, &_z, &_rad}){
+    array->reserve(n);
+  }
+  for (std::vector<float>* array : {&_x_single, &_y_single, &_z_single, &_rad_single}){
+    array->reserve(n);
+  }
+}
+
+void AtomKernel::AtomArrays::push(const double x, const double y, const double z, const double rad){
+  _x.push_back(x);
+  _y.push_back(y);
+  _z.push_back(z);
+  _rad.push_back(rad);
+  _x_single.push_back(x);
+  _y_single.push_back(y);
+  _z_single.push_back(z);
+  _rad_single.push_back(rad);
+}
+
+// the arrays grow at least geometrically, so that the stack reaches its final size after a few
+// voxels and is not reallocated afterwards
+template<typename T>
+AtomKernel::Buffer<T> AtomKernel::Stack<T>::reserve(const size_t n){
+  if (_size + n > _x.size()){
+    const size_t capacity = std::max(2*_x.size(), _size + n);
+    for (std::vector<T>* array : {&_x, &_y, &_z, &_rad}){
+      array->resize(capacity);
+    }
+  }
+  return {_x.data() + _size, _y.data() + _size, _z.data() + _size, _rad.data() + _size};
+}
+
+template class AtomKernel::Stack<double>;
+template class AtomKernel::Stack<float>;
+
+std::string AtomKernel::getImplementation(){
+#ifdef MV_ATOMKERNEL_X86
+  if (s_kernels<double>.classify == classifyAVX512<double,false>){return "AVX-512";}
+  if (s_kernels<double>.classify == classifyAVX2<double,false>){return "AVX2";}
+#endif
+  return "scalar";
+}
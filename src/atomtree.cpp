@@ -1,7 +1,8 @@
-
 #include "atomtree.h"
 #include "misc.h"
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 ///////////////////
 // AUX FUNCTIONS //
@@ -9,67 +10,6 @@
 
 double findMaxRad(std::vector<Atom>& list_of_atoms);
 
-//////////////
-// ATOMNODE //
-//////////////
-
-// CONSTRUCTOR
-
-AtomNode::AtomNode(AtomTree* tree, size_t atom_id, AtomNode* left_node, AtomNode* right_node) 
-  : _parent_tree(tree), _left_child(left_node), _right_child(right_node), _atom_id(atom_id) {}
-
-// DESTRUCTOR
-
-AtomNode::~AtomNode(){
-  delete _left_child;
-  delete _right_child;
-}
-
-// ACCESS
-
-const AtomNode* AtomNode::getLeftChild() const {
-  return _left_child;
-}
-
-const AtomNode* AtomNode::getRightChild() const {
-  return _right_child;
-}
-
-AtomNode* AtomNode::getLeftChild(){
-  return _left_child;
-}
-
-AtomNode* AtomNode::getRightChild(){
-  return _right_child;
-}
-
-Atom& AtomNode::getAtom() const {
-  return _parent_tree->getAtomList()[_atom_id];
-}
-
-size_t AtomNode::getAtomId() const {
-  return _atom_id;
-}
-
-// OTHER
-void AtomNode::print(){
-  std::cout << getAtom().symbol << "("
-    << getAtom().getCoordinate(0) << ","
-    << getAtom().getCoordinate(1) << ","
-    << getAtom().getCoordinate(2) << ")";
-
-  std::cout << "(-";
-  if(getLeftChild() != NULL){
-    getLeftChild()->print();
-  }
-  std::cout << " +";
-  if(getRightChild() != NULL){
-    getRightChild()->print();
-  }
-  std::cout << ")";
-  return;
-}
-
 //////////////
 // ATOMTREE //
 //////////////
@@ -77,51 +17,45 @@ void AtomNode::print(){
 // CONSTRUCTOR
 
 AtomTree::AtomTree(){
-  _root = NULL;
   _max_rad = 0;
+  _max_coord = 0;
+  calcSubtreeBounds(getRoot());
 }
 
-AtomTree::AtomTree(const std::vector<Atom>& list_of_atoms) : _atom_list(list_of_atoms){
-  _root = buildTree(0, getAtomList().size(), 0);
-  // ideally, the maximum radius would be the largest radius among all children of a node.
-  // this, however, may require running an algorithm for every tree node, increasing the
-  // complexity of the operation. it is much simpler to use the maximum radius among all
-  // atoms instead, sacrificing optimisation.
-  _max_rad = findMaxRad(getAtomList());
-}
-
-// DESTRUCTOR
+// the tree is built on a compact list of the atoms' positions and ids, which determines the order
+// of the atom list afterwards. this way, the atoms themselves are not swapped during the build
+AtomTree::AtomTree(const std::vector<Atom>& list_of_atoms){
+  std::vector<BuildEntry> entries;
+  entries.reserve(list_of_atoms.size());
+  for (size_t id = 0; id < list_of_atoms.size(); ++id){
+    entries.push_back({list_of_atoms[id].getPos(), id});
+  }
+  buildTree(entries, AtomNode(0, list_of_atoms.size(), 0));
 
-AtomTree::~AtomTree(){
-  delete _root;
+  _atom_list.reserve(list_of_atoms.size());
+  for (const BuildEntry& entry : entries){
+    _atom_list.push_back(list_of_atoms[entry.id]);
+  }
+  // the subtrees are pruned with the largest radius among their own atoms, so that a single large
+  // atom only affects the subtrees that contain it
+  _max_rad = findMaxRad(_atom_list);
+  storeAtomArrays();
+  calcSubtreeBounds(getRoot());
 }
 
 // FUNCTIONS USED BY CONSTRUCTOR
 
-// recursive function to generate a 3-d tree from a list of atoms
-// rather than copying the list of atoms in every recursion, or saving the partitioned
-// vectors, the original list of atoms is passed by reference and only the vector limits
-// are passed by value. any sorting during the tree building occurs in the original list
-AtomNode* AtomTree::buildTree(
-    size_t vec_first, // index of first vector element (default 0)
-    size_t vec_end, // vector size (index of last element + 1)
-    char dim){
-  // if list of atoms has no atoms left
-  if((vec_end-vec_first)==0){
-    return NULL;
-  }
-  // if list of atoms has exactly one atom left
-  else if((vec_end-vec_first)==1){
-    return new AtomNode(this, vec_first,NULL,NULL);
-  }
-
-  else{
-    quicksort(vec_first, vec_end, dim);
-    size_t median = vec_first + (vec_end-vec_first)/2; // operation rounds down
-    return new AtomNode(this, median, 
-        buildTree(vec_first, median, (dim+1)%3), 
-        buildTree(median+1, vec_end, (dim+1)%3));
-  }
+// recursive function to generate a 3-d tree from a list of atoms. the atoms in the range of a node
+// are partitioned around the median along the node's axis, so that the atoms of the left subtree
+// are not above and the atoms of the right subtree are not below the median. since the partition
+// runs in linear time, the tree is built in O(n log n), regardless of the order of the input
+void AtomTree::buildTree(std::vector<BuildEntry>& entries, const AtomNode& node){
+  if (node.isLeaf()){return;}
+  const char dim = node.getDim();
+  std::nth_element(entries.begin() + node.getFirst(), entries.begin() + node.getAtomId(), entries.begin() + node.getEnd(),
+      [dim](const BuildEntry& a, const BuildEntry& b){return a.pos[dim] < b.pos[dim];});
+  buildTree(entries, node.getLeftChild());
+  buildTree(entries, node.getRightChild());
 }
 
 double findMaxRad(std::vector<Atom>& list_of_atoms){
@@ -134,107 +68,200 @@ double findMaxRad(std::vector<Atom>& list_of_atoms){
   return max_rad;
 }
 
-
-void AtomTree::quicksort(const size_t vec_first, const size_t vec_end, const char dim){
-
-  if(vec_first+1 >= vec_end){
-    return;
+// the atom list is not modified after the tree has been built
+void AtomTree::storeAtomArrays(){
+  _max_coord = 0;
+  _atom_arrays.reserve(_atom_list.size());
+  for (const Atom& atom : _atom_list){
+    _atom_arrays.push(atom.pos_x, atom.pos_y, atom.pos_z, atom.rad);
+    _max_coord = std::max({_max_coord, std::abs(atom.pos_x), std::abs(atom.pos_y), std::abs(atom.pos_z)});
   }
+}
 
-  double pivot = _atom_list[vec_end-1].getCoordinate(dim);
-
-  int cntr = vec_first;
-
-  for(int i = vec_first; i < vec_end; i++){
-    if(_atom_list[i].getCoordinate(dim) <= pivot){
-      swap(_atom_list[cntr], _atom_list[i]);
-      cntr++;
+// the bounds of a subtree contain the bounds of both children and the node's own atoms. the bounds
+// of an empty subtree are infinitely far away from any point
+AtomTree::SubtreeBounds AtomTree::calcSubtreeBounds(const AtomNode& node){
+  SubtreeBounds bounds;
+  bounds.lower.fill(std::numeric_limits<num_type>::infinity());
+  bounds.upper.fill(-std::numeric_limits<num_type>::infinity());
+  bounds.max_rad = 0;
+  auto extend = [&bounds](const pos_type& lower, const pos_type& upper, const num_type rad){
+    for (char dim = 0; dim < 3; ++dim){
+      bounds.lower[dim] = std::min(bounds.lower[dim], lower[dim]);
+      bounds.upper[dim] = std::max(bounds.upper[dim], upper[dim]);
+    }
+    bounds.max_rad = std::max(bounds.max_rad, rad);
+  };
+  if (!node.isLeaf()){
+    for (const AtomNode& child : {node.getLeftChild(), node.getRightChild()}){
+      const SubtreeBounds child_bounds = calcSubtreeBounds(child);
+      extend(child_bounds.lower, child_bounds.upper, child_bounds.max_rad);
     }
   }
-  quicksort(vec_first, cntr-1, dim);
-  quicksort(cntr, vec_end, dim);
-
-  return;
-}
+  for (size_t id = node.getAtomId(); id < node.getAtomId() + node.getNumAtoms(); ++id){
+    extend(_atom_list[id].getPos(), _atom_list[id].getPos(), _atom_list[id].rad);
+  }
 
-void AtomTree::swap(Atom& a, Atom& b){
-  Atom temp = a;
-  a = b;
-  b = temp;
-  return;
+  if (node.getIndex() >= _subtree_bounds.size()){
+    _subtree_bounds.resize(node.getIndex() + 1);
+  }
+  _subtree_bounds[node.getIndex()] = bounds;
+  return bounds;
 }
 
 // for testing
 void AtomTree::print() const {
   std::cout << "Printing Tree" << std::endl;
-  if(_root == NULL){
+  if(_atom_list.empty()){
     std::cout << "Tree empty" << std::endl;
   }
   else{
-    _root->print();
+    printNode(getRoot());
   }
   std::cout << std::endl;
   return;
 }
 
+void AtomTree::printNode(const AtomNode& node) const {
+  for (size_t id = node.getAtomId(); id < node.getAtomId() + node.getNumAtoms(); ++id){
+    const Atom& atom = _atom_list[id];
+    std::cout << atom.symbol << "("
+      << atom.getCoordinate(0) << ","
+      << atom.getCoordinate(1) << ","
+      << atom.getCoordinate(2) << ")";
+  }
+  if (node.isLeaf()){return;}
+
+  std::cout << "(-";
+  printNode(node.getLeftChild());
+  std::cout << " +";
+  printNode(node.getRightChild());
+  std::cout << ")";
+  return;
+}
+
 // ACCESS
 
 const std::vector<Atom>& AtomTree::getAtomList() const {
   return _atom_list;
 }
 
-std::vector<Atom>& AtomTree::getAtomList() {
-  return _atom_list;
+const Atom& AtomTree::getAtom(const AtomNode& node) const {
+  return _atom_list[node.getAtomId()];
 }
 
-const double AtomTree::getMaxRad() const {
+double AtomTree::getMaxRad() const {
   return _max_rad;
 }
 
-const AtomNode* AtomTree::getRoot() const {
-  return _root;
+AtomNode AtomTree::getRoot() const {
+  return AtomNode(0, _atom_list.size(), 0);
+}
+
+// the distances along the axes are never larger than those to any atom of the subtree, also after
+// rounding. therefore, the squared distance is a lower bound for the squared distance to any atom
+AtomTree::num_type AtomTree::calcSqrDistToSubtree(const AtomNode& node, const pos_type& pos) const {
+  const SubtreeBounds& bounds = _subtree_bounds[node.getIndex()];
+  pos_type gap;
+  for (char dim = 0; dim < 3; ++dim){
+    gap[dim] = std::max({bounds.lower[dim] - pos[dim], pos[dim] - bounds.upper[dim], num_type(0)});
+  }
+  return (gap[0]*gap[0] + gap[1]*gap[1]) + gap[2]*gap[2];
 }
 
 // Returns a vector containing atom IDs of all atoms whose distance from the atom's center
 // is equal or below a specified maximal distance + the radius of the atom.
 // Can be used to find all atoms that are touching or intersecting a sphere.
-std::vector<size_t> AtomTree::listAllWithin(const typename AtomTree::pos_type pos, const double max_dist) const {
+// Optionally, returns the number of visited nodes.
+std::vector<size_t> AtomTree::listAllWithin(const pos_type pos, const double max_dist, size_t* n_visited) const {
   std::vector<size_t> id_list;
 
-  std::vector<std::pair<AtomNode*,char>> to_visit;
-  to_visit.push_back(std::make_pair(_root,0));
-  
+  std::vector<AtomNode> to_visit = {getRoot()};
+  size_t n_visits = 0;
+
   while (!to_visit.empty()) {
-    auto node_dim = to_visit.back();
+    const AtomNode node = to_visit.back();
     to_visit.pop_back();
-    // Skip if nullptr
-    if (node_dim.first == nullptr) continue;
-    AtomNode& node = *node_dim.first;
-    char dim = node_dim.second;
-
-    num_type at_pos_dim = node.getAtom().getCoordinate(dim);
-    num_type dist1D = pos[dim] - at_pos_dim;
+    ++n_visits;
 
-    // If distance along current direction is smaller than threshold then check
-    // this node's atom for match and visit both children.
-    if (abs(dist1D) <= max_dist + _max_rad) {
+    // Skip the subtree if all of its atoms are too far away.
+    if (std::sqrt(calcSqrDistToSubtree(node, pos)) > max_dist + getMaxRadInSubtree(node)) continue;
 
-      if (distance(node.getAtom().getPos(), pos) <= max_dist + node.getAtom().rad) {
-        id_list.push_back(node.getAtomId());
+    for (size_t id = node.getAtomId(); id < node.getAtomId() + node.getNumAtoms(); ++id) {
+      if (distance(_atom_list[id].getPos(), pos) <= max_dist + _atom_list[id].rad) {
+        id_list.push_back(id);
       }
-
-      to_visit.push_back(std::make_pair(node.getLeftChild(), (dim+1)%3));
-      to_visit.push_back(std::make_pair(node.getRightChild(), (dim+1)%3));
     }
-    // If distance is larger then visit either left or right child, depending on
-    // relation of the atom and the point.
-    else {
-      to_visit.push_back(std::make_pair(
-            dist1D < 0? node.getLeftChild() : node.getRightChild(),
-            (dim+1)%3));
+
+    if (!node.isLeaf()) {
+      to_visit.push_back(node.getLeftChild());
+      to_visit.push_back(node.getRightChild());
     }
   }
 
+  if (n_visited) *n_visited = n_visits;
   return id_list;
 }
 
+unsigned long AtomTree::classifyVoxel(const AtomKernel::Query<double>& query, unsigned char& relations, const double rad_select, AtomKernel::Stack<double>& selected) const {
+  return classifyVoxelInPrecision(query, relations, rad_select, selected);
+}
+
+unsigned long AtomTree::classifyVoxel(const AtomKernel::Query<float>& query, unsigned char& relations, const float rad_select, AtomKernel::Stack<float>& selected) const {
+  return classifyVoxelInPrecision(query, relations, rad_select, selected);
+}
+
+// the subtrees are pruned with a margin for the rounding errors of the classification, which
+// matters in single precision
+template<typename T>
+unsigned long AtomTree::classifyVoxelInPrecision(const AtomKernel::Query<T>& query, unsigned char& relations, const T rad_select, AtomKernel::Stack<T>& selected) const {
+  const double max_reach = (_max_rad + std::max<double>(query.rad_probe, 0)) + std::max(query.rad_vxl, rad_select);
+  const double margin = AtomKernel::calcRoundingMargin<T>(_max_coord + max_reach);
+  unsigned long n_visits = 0;
+  traverseTree(getRoot(), query, relations, rad_select, margin, selected, n_visits);
+  return n_visits;
+}
+
+// goes through all close atoms and combines their relations to a voxel. the traversal ends as soon
+// as the voxel is found to be completely inside an atom
+template<typename T>
+void AtomTree::traverseTree
+  (const AtomNode& node,
+   const AtomKernel::Query<T>& query,
+   unsigned char& relations,
+   const T rad_select,
+   const double margin,
+   AtomKernel::Stack<T>& selected,
+   unsigned long& n_visits) const {
+
+  if (relations & mvREL_INSIDE){return;}
+  ++n_visits;
+  // a subtree is skipped, if its atoms are too far away to touch the voxel or a probe touching it.
+  // the largest radius gives the largest limit of all relations (see AtomKernel)
+  const double reach = (getMaxRadInSubtree(node) + std::max<double>(query.rad_probe, 0)) + std::max(query.rad_vxl, rad_select) + margin;
+  if (calcSqrDistToSubtree(node, {query.pos[0], query.pos[1], query.pos[2]}) >= reach*reach){return;}
+
+  const AtomKernel::Bucket<T> bucket = getBucket<T>(node);
+  // the atoms of a leaf node are classified all at once. a single atom is faster to classify
+  // without SIMD
+  if (rad_select < 0){
+    relations |= node.isLeaf()?
+      AtomKernel::classify(bucket, node.getNumAtoms(), query) : AtomKernel::classifyScalar(bucket, 1, query);
+  }
+  else {
+    const AtomKernel::Buffer<T> buffer = selected.reserve(node.getNumAtoms());
+    selected.push(node.isLeaf()?
+      AtomKernel::classifyAndSelect(bucket, node.getNumAtoms(), query, rad_select, buffer, relations) :
+      AtomKernel::classifyAndSelectScalar(bucket, 1, query, rad_select, buffer, relations));
+  }
+  if (node.isLeaf()){return;}
+
+  // the child on the side of the voxel is visited first, since it more likely contains an atom
+  // that the voxel is inside of
+  const char dim = node.getDim();
+  const T dist1D = query.pos[dim] - (dim == 0? *bucket.x : (dim == 1? *bucket.y : *bucket.z));
+  const AtomNode near_child = dist1D < 0? node.getLeftChild() : node.getRightChild();
+  const AtomNode far_child = dist1D < 0? node.getRightChild() : node.getLeftChild();
+  traverseTree(near_child, query, relations, rad_select, margin, selected, n_visits);
+  traverseTree(far_child, query, relations, rad_select, margin, selected, n_visits);
+}
@@ -25,6 +25,13 @@ static const wxCmdLineEntryDesc s_cmd_line_desc[] =
   { wxCMD_LINE_OPTION, "do", "dir-output", "Path to the output directory", wxCMD_LINE_VAL_STRING},
   { wxCMD_LINE_OPTION, "r2", "radius2", "Large probe radius (for two-probe mode)", wxCMD_LINE_VAL_DOUBLE},
   { wxCMD_LINE_OPTION, "d", "depth", "Octree depth", wxCMD_LINE_VAL_NUMBER},
+  { wxCMD_LINE_OPTION, "t", "threads", "Number of threads used for the calculation, 0 uses all cores (default:1)", wxCMD_LINE_VAL_NUMBER},
+  { wxCMD_LINE_SWITCH, "sp", "sparse", "Store the octree sparsely to reduce memory usage at fine resolutions", wxCMD_LINE_VAL_NONE, 0},
+  { wxCMD_LINE_OPTION, "mb", "memory-budget", "Memory budget for the grid in MB. Larger grids are processed in slabs (default:0, no limit)", wxCMD_LINE_VAL_NUMBER},
+  { wxCMD_LINE_SWITCH, "ad", "auto-depth", "Choose the octree depth with the lowest predicted runtime within the memory budget (overrides -d)", wxCMD_LINE_VAL_NONE, 0},
+  { wxCMD_LINE_OPTION, "ai", "atom-index", "Spatial index used to find the atoms close to a voxel: tree, cells or auto (default:auto)", wxCMD_LINE_VAL_STRING},
+  { wxCMD_LINE_OPTION, "pr", "precision", "Precision in which voxels are classified against atoms: double or single (default:double)", wxCMD_LINE_VAL_STRING},
+  { wxCMD_LINE_SWITCH, "dt", "distance-transform", "Assign the probe shells with a distance transform, whose runtime does not depend on the probe radius (not with -sp)", wxCMD_LINE_VAL_NONE, 0},
   { wxCMD_LINE_SWITCH, "ht", "hetatm", "Include HETATM from pdb file", wxCMD_LINE_VAL_NONE, 0},
   { wxCMD_LINE_SWITCH, "uc", "unitcell", "Evaluate unit cell", wxCMD_LINE_VAL_NONE, 0},
   { wxCMD_LINE_SWITCH, "sf", "surface", "Calculate surfaces", wxCMD_LINE_VAL_NONE, 0},
@@ -41,6 +48,11 @@ static const wxCmdLineEntryDesc s_cmd_line_desc[] =
 static const std::vector<std::string> s_required_args = {"radius", "grid", "file-structure"};
 
 bool validateProbes(const double, const double, const bool);
+bool validateThreads(const long);
+bool validateMemoryBudget(const long, const bool);
+bool validateDistanceTransform(const bool, const bool);
+bool validateAtomIndex(const std::string, mvINDEX&);
+bool validatePrecision(const std::string, mvPRECISION&);
 bool validateExport(const std::string, const std::vector<bool>);
 bool validatePdb(const std::string, const bool, const bool);
 unsigned evalDisplayOptions(const std::string);
@@ -104,8 +116,15 @@ void MainApp::evalCmdLine(){
   wxString elements_file_path = Ctrl::getDefaultElemPath();
   wxString output_dir_path = "";
   wxString output = "all";
+  wxString atom_index = "auto";
+  wxString precision = "double";
   double probe_radius_l = 0;
   long tree_depth = 4;
+  long n_threads = 1;
+  long memory_budget = 0;
+  bool opt_sparse_octree = false;
+  bool opt_auto_depth = false;
+  bool opt_distance_transform = false;
   bool opt_include_hetatm = false;
   bool opt_unit_cell = false;
   bool opt_surface_area = false;
@@ -113,12 +132,21 @@ void MainApp::evalCmdLine(){
   bool exp_report = false;
   bool exp_total_map = false;
   bool exp_cavity_maps = false;
+  mvINDEX atom_index_type = mvINDEX_AUTO;
+  mvPRECISION precision_type = mvPRECISION_DOUBLE;
 
   parser.Found("fe",&elements_file_path);
   parser.Found("do",&output_dir_path);
   parser.Found("o",&output);
+  parser.Found("ai",&atom_index);
+  parser.Found("pr",&precision);
   parser.Found("r2",&probe_radius_l);
   parser.Found("d",&tree_depth);
+  parser.Found("t",&n_threads);
+  parser.Found("mb",&memory_budget);
+  opt_sparse_octree = parser.Found("sp");
+  opt_auto_depth = parser.Found("ad");
+  opt_distance_transform = parser.Found("dt");
   opt_include_hetatm = parser.Found("ht");
   opt_unit_cell = parser.Found("uc");
   opt_surface_area = parser.Found("sf");
@@ -128,6 +156,11 @@ void MainApp::evalCmdLine(){
   exp_cavity_maps = parser.Found("xc");
 
   if(!validateProbes(probe_radius_s, probe_radius_l, opt_probe_mode)
+      || !validateThreads(n_threads)
+      || !validateMemoryBudget(memory_budget, opt_unit_cell)
+      || !validateDistanceTransform(opt_distance_transform, opt_sparse_octree)
+      || !validateAtomIndex(atom_index.ToStdString(), atom_index_type)
+      || !validatePrecision(precision.ToStdString(), precision_type)
       || !validateExport(output_dir_path.ToStdString(), {exp_report, exp_total_map, exp_cavity_maps})
       || !validatePdb(structure_file_path.ToStdString(), opt_include_hetatm, opt_unit_cell)){
     return;
@@ -151,7 +184,14 @@ void MainApp::evalCmdLine(){
       exp_report,
       exp_total_map,
       exp_cavity_maps,
-      display_flag);
+      display_flag,
+      (unsigned)n_threads,
+      opt_sparse_octree,
+      (unsigned long)memory_budget,
+      opt_auto_depth,
+      opt_distance_transform,
+      atom_index_type,
+      precision_type);
 }
 
 bool validateProbes(const double r1, const double r2, const bool pm){
@@ -162,6 +202,63 @@ bool validateProbes(const double r1, const double r2, const bool pm){
   return true;
 }
 
+bool validateThreads(const long n_threads){
+  if(n_threads < 0){
+    Ctrl::getInstance()->displayErrorMessage(116);
+    return false;
+  }
+  return true;
+}
+
+bool validateMemoryBudget(const long memory_budget, const bool unitcell){
+  if(memory_budget < 0){
+    Ctrl::getInstance()->displayErrorMessage(117);
+    return false;
+  }
+  if(memory_budget > 0 && unitcell){
+    Ctrl::getInstance()->displayErrorMessage(118);
+    return false;
+  }
+  return true;
+}
+
+bool validateDistanceTransform(const bool distance_transform, const bool sparse_octree){
+  if(distance_transform && sparse_octree){
+    Ctrl::getInstance()->displayErrorMessage(119);
+    return false;
+  }
+  return true;
+}
+
+static const std::map<std::string,mvINDEX> s_atom_index_map {
+  {"auto", mvINDEX_AUTO},
+  {"tree", mvINDEX_TREE},
+  {"cells", mvINDEX_CELLS}
+};
+
+bool validateAtomIndex(const std::string atom_index, mvINDEX& atom_index_type){
+  if (s_atom_index_map.find(atom_index) == s_atom_index_map.end()){
+    Ctrl::getInstance()->displayErrorMessage(120);
+    return false;
+  }
+  atom_index_type = s_atom_index_map.at(atom_index);
+  return true;
+}
+
+static const std::map<std::string,mvPRECISION> s_precision_map {
+  {"double", mvPRECISION_DOUBLE},
+  {"single", mvPRECISION_SINGLE}
+};
+
+bool validatePrecision(const std::string precision, mvPRECISION& precision_type){
+  if (s_precision_map.find(precision) == s_precision_map.end()){
+    Ctrl::getInstance()->displayErrorMessage(121);
+    return false;
+  }
+  precision_type = s_precision_map.at(precision);
+  return true;
+}
+
 bool validateExport(const std::string out_dir, const std::vector<bool> exp_options){
   bool any_option_on = isIncluded(true,exp_options);
   if (any_option_on && out_dir.empty()){
@@ -243,6 +243,10 @@ const Container3D<Voxel>& MainFrame::getSurfaceData() const {
   return Ctrl::getInstance()->getSurfaceData();
 }
 
+CavityID MainFrame::getCavityID(const std::array<unsigned,3>& index) const {
+  return Ctrl::getInstance()->getCavityID(index);
+}
+
 ///////////////
 // ON EXPORT //
 ///////////////
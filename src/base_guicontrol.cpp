@@ -53,7 +53,7 @@ void MainFrame::extOpenErrorDialog(const int error_code, const std::string& erro
 }
 
 void MainFrame::extRenderSurface(const Container3D<Voxel>& surf_data, const std::array<double,3> origin, 
-    const double grid_step, const bool probe_mode, const unsigned char n_cavities, const std::vector<Atom>& atomlist){
+    const double grid_step, const bool probe_mode, const size_t n_cavities, const std::vector<Atom>& atomlist){
 
   auto render = [this, surf_data, origin, grid_step, probe_mode, n_cavities, atomlist](){
     renderMolecule(atomlist);
@@ -279,7 +279,7 @@ void MainFrame::renderMolecule(const std::vector<Atom>& atomlist){
 }
 
 void MainFrame::renderSurface(const Container3D<Voxel>& surf_data, const std::array<double,3> origin, 
-    const double grid_step, const std::pair<bool,unsigned char> args){
+    const double grid_step, const std::pair<bool,size_t> args){
 #ifdef MOLOVOL_RENDERER
   m_renderWin->UpdateSurface(surf_data, origin, grid_step, args.first, args.second);
   
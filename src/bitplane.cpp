@@ -0,0 +1,46 @@
+#include "bitplane.h"
+
+/////////////////
+// CONSTRUCTOR //
+/////////////////
+
+BitPlane::BitPlane(const std::array<unsigned,3>& start, const std::array<unsigned,3>& end)
+  : _start(start), _end(end) {
+  for (char dim = 0; dim < 3; ++dim){
+    if (_end[dim] < _start[dim]){_end[dim] = _start[dim];}
+  }
+  _n_words_per_row = (_end[0] - _start[0] + word_bits - 1) / word_bits;
+  _words = std::vector<word_type>(_n_words_per_row * (_end[1] - _start[1]) * (_end[2] - _start[2]), 0);
+}
+
+////////////
+// ACCESS //
+////////////
+
+bool BitPlane::getBit(const std::array<unsigned,3>& index) const {
+  const unsigned x = index[0] - _start[0];
+  return (_words[calcRowStart(index[1], index[2]) + x / word_bits] >> (x % word_bits)) & 1;
+}
+
+void BitPlane::setBit(const std::array<unsigned,3>& index){
+  const unsigned x = index[0] - _start[0];
+  _words[calcRowStart(index[1], index[2]) + x / word_bits] |= word_type(1) << (x % word_bits);
+}
+
+void BitPlane::setBits(const std::array<unsigned,3>& index, const unsigned n){
+  if (n == 0){return;}
+  const unsigned first = index[0] - _start[0];
+  const unsigned last = first + n - 1;
+  word_type* row = &_words[calcRowStart(index[1], index[2])];
+  const word_type first_mask = ~word_type(0) << (first % word_bits);
+  const word_type last_mask = ~word_type(0) >> (word_bits - 1 - last % word_bits);
+  if (first / word_bits == last / word_bits){
+    row[first / word_bits] |= first_mask & last_mask;
+    return;
+  }
+  row[first / word_bits] |= first_mask;
+  for (size_t i = first / word_bits + 1; i < last / word_bits; ++i){
+    row[i] = ~word_type(0);
+  }
+  row[last / word_bits] |= last_mask;
+}
@@ -0,0 +1,198 @@
+#include "celllist.h"
+#include "misc.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// the cell ranges and the distances to the rows of cells are computed from the cell size, while
+// the atoms have been sorted into the cells by rounded divisions. a small margin on the search
+// radius covers the difference
+static constexpr double s_margin = 1e-6;
+
+//////////////
+// CELLLIST //
+//////////////
+
+// CONSTRUCTOR
+
+CellList::CellList(){
+  _cell_start = {0};
+}
+
+// the atoms are sorted into the cells with a counting sort, which keeps the input order of the
+// atoms within each cell
+CellList::CellList(const std::vector<Atom>& list_of_atoms, const num_type cell_size){
+  _cell_start = {0};
+  if (list_of_atoms.empty()){return;}
+
+  pos_type upper;
+  _origin.fill(std::numeric_limits<num_type>::infinity());
+  upper.fill(-std::numeric_limits<num_type>::infinity());
+  for (const Atom& atom : list_of_atoms){
+    for (char dim = 0; dim < 3; ++dim){
+      _origin[dim] = std::min(_origin[dim], atom.getCoordinate(dim));
+      upper[dim] = std::max(upper[dim], atom.getCoordinate(dim));
+    }
+    _max_rad = std::max(_max_rad, atom.rad);
+    _max_coord = std::max({_max_coord, std::abs(atom.pos_x), std::abs(atom.pos_y), std::abs(atom.pos_z)});
+  }
+
+  _cell_size = cell_size > 0? cell_size : 1;
+  const size_t max_cells = s_max_cells_per_atom * list_of_atoms.size();
+  while (true){
+    size_t n_total = 1;
+    for (char dim = 0; dim < 3; ++dim){
+      _n_cells[dim] = static_cast<size_t>(std::floor((upper[dim] - _origin[dim]) / _cell_size)) + 1;
+      n_total *= _n_cells[dim];
+    }
+    if (n_total <= max_cells){break;}
+    _cell_size *= 1.01 * std::cbrt(double(n_total) / max_cells);
+  }
+
+  std::vector<size_t> atom_cells;
+  atom_cells.reserve(list_of_atoms.size());
+  _cell_start.assign(_n_cells[0] * _n_cells[1] * _n_cells[2] + 1, 0);
+  for (const Atom& atom : list_of_atoms){
+    const size_t cell = calcCellIndex({findCell(atom.pos_x, 0), findCell(atom.pos_y, 1), findCell(atom.pos_z, 2)});
+    atom_cells.push_back(cell);
+    ++_cell_start[cell + 1];
+  }
+  for (size_t cell = 1; cell < _cell_start.size(); ++cell){
+    _cell_start[cell] += _cell_start[cell - 1];
+  }
+
+  std::vector<size_t> order(list_of_atoms.size());
+  std::vector<size_t> fill(_cell_start.begin(), _cell_start.end() - 1);
+  for (size_t id = 0; id < list_of_atoms.size(); ++id){
+    order[fill[atom_cells[id]]++] = id;
+  }
+  _atom_arrays.reserve(list_of_atoms.size());
+  _atom_list.reserve(list_of_atoms.size());
+  for (const size_t id : order){
+    const Atom& atom = list_of_atoms[id];
+    _atom_list.push_back(atom);
+    _atom_arrays.push(atom.pos_x, atom.pos_y, atom.pos_z, atom.rad);
+  }
+}
+
+// ACCESS
+
+double CellList::getMaxRad() const {
+  return _max_rad;
+}
+
+const std::vector<Atom>& CellList::getAtomList() const {
+  return _atom_list;
+}
+
+double CellList::getOccupancy() const {
+  const size_t n_total = _cell_start.size() - 1;
+  if (n_total == 0){return 0;}
+  size_t n_occupied = 0;
+  for (size_t cell = 0; cell < n_total; ++cell){
+    n_occupied += _cell_start[cell + 1] > _cell_start[cell];
+  }
+  return double(n_occupied) / n_total;
+}
+
+// HELPERS
+
+size_t CellList::calcCellIndex(const std::array<size_t,3>& cell) const {
+  return cell[0] + _n_cells[0] * (cell[1] + _n_cells[1] * cell[2]);
+}
+
+// cell along one axis that contains a coordinate. coordinates outside of the grid are assigned to
+// the closest cell
+size_t CellList::findCell(const num_type coord, const char dim) const {
+  const num_type cell = std::floor((coord - _origin[dim]) / _cell_size);
+  if (!(cell > 0)){return 0;}
+  return std::min(static_cast<size_t>(std::min(cell, num_type(_n_cells[dim]))), _n_cells[dim] - 1);
+}
+
+// range of cells, whose atoms may be closer to a point than the given distance. returns false, if
+// the range lies outside of the grid
+bool CellList::findCellRange(const pos_type& pos, const num_type reach, std::array<size_t,3>& lower, std::array<size_t,3>& upper) const {
+  if (_atom_list.empty()){return false;}
+  for (char dim = 0; dim < 3; ++dim){
+    if (pos[dim] + reach < _origin[dim] || pos[dim] - reach > _origin[dim] + _n_cells[dim] * _cell_size){return false;}
+    lower[dim] = findCell(pos[dim] - reach, dim);
+    upper[dim] = findCell(pos[dim] + reach, dim);
+  }
+  return true;
+}
+
+// squared distance from a point to the row of cells along x with the given y and z indices
+CellList::num_type CellList::calcSqrDistToRow(const pos_type& pos, const size_t y, const size_t z) const {
+  num_type sqr_dist = 0;
+  for (const auto& [dim, cell] : {std::pair<char,size_t>(1, y), std::pair<char,size_t>(2, z)}){
+    const num_type lower = _origin[dim] + cell * _cell_size;
+    const num_type gap = std::max({lower - pos[dim], pos[dim] - (lower + _cell_size), num_type(0)});
+    sqr_dist += gap*gap;
+  }
+  return sqr_dist;
+}
+
+// SEARCH
+
+unsigned long CellList::classifyVoxel(const AtomKernel::Query<double>& query, unsigned char& relations, const double rad_select, AtomKernel::Stack<double>& selected) const {
+  return classifyVoxelInPrecision(query, relations, rad_select, selected);
+}
+
+unsigned long CellList::classifyVoxel(const AtomKernel::Query<float>& query, unsigned char& relations, const float rad_select, AtomKernel::Stack<float>& selected) const {
+  return classifyVoxelInPrecision(query, relations, rad_select, selected);
+}
+
+// the atoms of a row of cells are contiguous and are classified at once. rows that are too far
+// away from the voxel are skipped. the search radius includes the rounding errors of the
+// classification, which matter in single precision
+template<typename T>
+unsigned long CellList::classifyVoxelInPrecision(const AtomKernel::Query<T>& query, unsigned char& relations, const T rad_select, AtomKernel::Stack<T>& selected) const {
+  if (relations & mvREL_INSIDE){return 0;}
+  num_type reach = (_max_rad + std::max<num_type>(query.rad_probe, 0)) + std::max(query.rad_vxl, rad_select) + s_margin;
+  reach += AtomKernel::calcRoundingMargin<T>(_max_coord + reach);
+  const pos_type pos = {query.pos[0], query.pos[1], query.pos[2]};
+  std::array<size_t,3> lower, upper;
+  if (!findCellRange(pos, reach, lower, upper)){return 0;}
+
+  unsigned long n_visits = 0;
+  for (size_t z = lower[2]; z <= upper[2]; ++z){
+    for (size_t y = lower[1]; y <= upper[1]; ++y){
+      if (calcSqrDistToRow(pos, y, z) >= reach*reach){continue;}
+      n_visits += upper[0] - lower[0] + 1;
+      const size_t first = _cell_start[calcCellIndex({lower[0], y, z})];
+      const size_t n = _cell_start[calcCellIndex({upper[0], y, z}) + 1] - first;
+      const AtomKernel::Bucket<T> bucket = _atom_arrays.getBucket<T>(first);
+      if (rad_select < 0){
+        relations |= AtomKernel::classify(bucket, n, query);
+      }
+      else {
+        const AtomKernel::Buffer<T> buffer = selected.reserve(n);
+        selected.push(AtomKernel::classifyAndSelect(bucket, n, query, rad_select, buffer, relations));
+      }
+      if (relations & mvREL_INSIDE){return n_visits;}
+    }
+  }
+  return n_visits;
+}
+
+std::vector<size_t> CellList::listAllWithin(const pos_type pos, const double max_dist, size_t* n_visited) const {
+  std::vector<size_t> id_list;
+  size_t n_visits = 0;
+  const num_type reach = max_dist + _max_rad + s_margin;
+  std::array<size_t,3> lower, upper;
+  if (findCellRange(pos, reach, lower, upper)){
+    for (size_t z = lower[2]; z <= upper[2]; ++z){
+      for (size_t y = lower[1]; y <= upper[1]; ++y){
+        if (calcSqrDistToRow(pos, y, z) >= reach*reach){continue;}
+        n_visits += upper[0] - lower[0] + 1;
+        for (size_t id = _cell_start[calcCellIndex({lower[0], y, z})]; id < _cell_start[calcCellIndex({upper[0], y, z}) + 1]; ++id){
+          if (distance(_atom_list[id].getPos(), pos) <= max_dist + _atom_list[id].rad){
+            id_list.push_back(id);
+          }
+        }
+      }
+    }
+  }
+  if (n_visited){*n_visited = n_visits;}
+  return id_list;
+}
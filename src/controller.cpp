@@ -168,7 +168,7 @@ bool Ctrl::runCalculation(){
   if (data.success){
     renderSurface(_current_calculation->getSurfaceData(), _current_calculation->getCellOrigin(),
         data.grid_step, data.probe_mode, 
-        data.cavities.size(), _current_calculation->getAtomTree().getAtomList());
+        data.cavities.size(), _current_calculation->getAtomIndex().getAtomList());
     // export if appropriate option is toggled
     if(data.make_report){exportReport();}
     if(data.make_full_map){exportSurfaceMap(false);}
@@ -194,7 +194,14 @@ bool Ctrl::runCalculation(
     const bool exp_report,
     const bool exp_total_map,
     const bool exp_cavity_maps,
-    const unsigned display_flag){
+    const unsigned display_flag,
+    const unsigned n_threads,
+    const bool opt_sparse_octree,
+    const unsigned long memory_budget,
+    const bool opt_auto_depth,
+    const bool opt_distance_transform,
+    const mvINDEX atom_index,
+    const mvPRECISION precision){
   if(_current_calculation == NULL){_current_calculation = new Model();}
 
   try{_current_calculation->readAtomsFromFile(structure_file_path, opt_include_hetatm);}
@@ -234,6 +241,13 @@ bool Ctrl::runCalculation(
     exp_cavity_maps,
     _current_calculation->getRadiusMap(),
     _current_calculation->listElementsInStructure());
+  _current_calculation->setNumThreads(n_threads);
+  _current_calculation->setSparseOctree(opt_sparse_octree);
+  _current_calculation->setMemoryBudget(memory_budget);
+  _current_calculation->setAutoDepth(opt_auto_depth);
+  _current_calculation->setDistanceTransform(opt_distance_transform);
+  _current_calculation->setAtomIndex(atom_index);
+  _current_calculation->setPrecision(precision);
 
   CalcReportBundle data = _current_calculation->generateData();
 
@@ -514,7 +528,7 @@ void Ctrl::updateProgressBar(const int percentage){
 }
 
 void Ctrl::renderSurface(const Container3D<Voxel>& surf_data, const std::array<double,3> origin, 
-    const double grid_step, const bool probe_mode, const unsigned char n_cavities, const std::vector<Atom>& atomlist) {
+    const double grid_step, const bool probe_mode, const size_t n_cavities, const std::vector<Atom>& atomlist) {
   if (_to_gui) {
     s_gui->extRenderSurface(surf_data, origin, grid_step, probe_mode, n_cavities, atomlist);
   }
@@ -524,6 +538,10 @@ const Container3D<Voxel>& Ctrl::getSurfaceData() const {
   return _current_calculation->getSurfaceData();
 };
 
+CavityID Ctrl::getCavityID(const std::array<unsigned,3>& index) const {
+  return _current_calculation->getCavityID(index);
+}
+
 ////////////
 // EXPORT //
 ////////////
@@ -615,14 +633,22 @@ static const std::map<int, std::string> s_error_codes = {
   {113, "Space group or symmetry not found. Check the structure and space group files or untick the Unit Cell Analysis tickbox"},
   {114, "Invalid ATOM or HETATM line encountered. Import may be incomplete. Check the structure file."},
   {115, "Invalid option(s). You may have selected an option that is incompatible with the structure file format."},
+  {116, "Invalid number of threads. Please provide a positive number, or 0 to use all available cores."},
+  {117, "Invalid memory budget. Please provide a positive number of megabytes, or 0 to keep the whole grid in memory."},
+  {118, "The memory budget cannot be combined with the unit cell analysis."},
+  {119, "The distance transform requires the dense grid and cannot be combined with the sparse octree."},
+  {120, "Invalid atom index. Please choose tree, cells or auto."},
+  {121, "Invalid precision. Please choose double or single."},
   // 2xx: Issue during Calculation
   {200, "Calculation failed!"},
-  {201, "Total number of cavities (255) exceeded. Consider changing the probe size. Calculation will proceed."},
+  {201, "Too many cavities (255) in a small region of the grid. Some cavities might be incomplete. Consider changing the probe size. Calculation will proceed."},
+  {202, "The memory budget is too small for a single slab of the grid. Please increase the memory budget or the grid step."},
   // 3xx: Issue with Output
   {300, "Output failed!"},
   {301, "Data missing to export file. Calculation may be still running or has not been started."},
   {302, "Invalid output directory. Please select a valid output directory."},
   {303, "An unidentified issue has been encountered while writing the surface map."},
+  {304, "Surface maps cannot be exported when the grid is processed in slabs. Please increase the memory budget."},
   // 9xx: Issues with command line arguments
   {900, "Command line interface failed!"},
   {902, "Invalid output display option. At least one parameter belonging to '-o' is invalid and will be ignored."},
@@ -0,0 +1,127 @@
+#include "distancetransform.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <limits>
+
+/////////////////
+// CONSTRUCTOR //
+/////////////////
+
+DistanceTransform::DistanceTransform(const std::array<unsigned,3>& size, const value_type limit)
+  : _size(size), _limit(std::min(limit, std::numeric_limits<value_type>::max() - 1)) {
+  _values = std::vector<value_type>(size_t(_size[0]) * _size[1] * _size[2], _limit + 1);
+}
+
+///////////////
+// TRANSFORM //
+///////////////
+
+namespace {
+  // buffers that are reused for every line of one thread
+  struct LineBuffers{
+    std::vector<DistanceTransform::value_type> line;
+    std::vector<DistanceTransform::value_type> result;
+    std::vector<unsigned> vertices; // positions of the parabolas in the lower envelope
+    std::vector<double> bounds; // the parabola k is the lowest between bounds k and k+1
+  };
+
+  // computes min_p ((q-p)^2 + f(p)) for the values f along a line. results above the limit are
+  // clamped to limit+1. the clamping does not change any result up to the limit, since these
+  // only depend on values that are below the limit themselves
+  void transformLine(LineBuffers& buf, const unsigned n, const DistanceTransform::value_type limit){
+    const std::vector<DistanceTransform::value_type>& f = buf.line;
+    std::vector<unsigned>& v = buf.vertices;
+    std::vector<double>& z = buf.bounds;
+    auto intersect = [&f](const unsigned q, const unsigned p){
+      return ((double(f[q]) + double(q)*q) - (double(f[p]) + double(p)*p)) / (2.0*q - 2.0*p);
+    };
+    // lower envelope of the parabolas
+    unsigned k = 0;
+    v[0] = 0;
+    z[0] = -std::numeric_limits<double>::infinity();
+    z[1] = std::numeric_limits<double>::infinity();
+    for (unsigned q = 1; q < n; ++q){
+      double s = intersect(q, v[k]);
+      while (s <= z[k]){
+        --k;
+        s = intersect(q, v[k]);
+      }
+      ++k;
+      v[k] = q;
+      z[k] = s;
+      z[k+1] = std::numeric_limits<double>::infinity();
+    }
+    // evaluate the envelope
+    k = 0;
+    for (unsigned q = 0; q < n; ++q){
+      while (z[k+1] < q){++k;}
+      const unsigned long long diff = q > v[k]? q - v[k] : v[k] - q;
+      buf.result[q] = DistanceTransform::value_type(std::min(diff*diff + f[v[k]], limit + 1ull));
+    }
+  }
+}
+
+void DistanceTransform::compute(const ThreadPool& pool){
+  for (char dim = 0; dim < 3; ++dim){
+    transformAlongAxis(pool, dim);
+  }
+}
+
+// transforms all lines along one axis. lines along y and z are processed in batches of
+// neighbouring lines along x, which are adjacent in memory
+void DistanceTransform::transformAlongAxis(const ThreadPool& pool, const char dim){
+  static constexpr unsigned batch_size = 16;
+  const unsigned n = _size[dim];
+  if (n == 0){return;}
+  const size_t stride = dim == 0? 1 : (dim == 1? _size[0] : size_t(_size[0]) * _size[1]);
+  // the lines are grouped by their coordinates along the two remaining axes. lines along x are
+  // processed one by one, the other axes in batches along x
+  const char outer_dim = dim == 2? 1 : 2;
+  const unsigned n_batch = dim == 0? 1 : batch_size;
+  const unsigned n_x = dim == 0? _size[1] : _size[0];
+
+  std::vector<LineBuffers> buffers(pool.getNumThreads());
+  for (LineBuffers& buf : buffers){
+    buf.line.resize(n);
+    buf.result.resize(n);
+    buf.vertices.resize(n);
+    buf.bounds.resize(n+1);
+  }
+  std::vector<std::vector<value_type>> batches(pool.getNumThreads(), std::vector<value_type>(size_t(n) * n_batch));
+
+  pool.parallelFor(_size[outer_dim],
+    [&](const size_t outer, const unsigned thread_id){
+      LineBuffers& buf = buffers[thread_id];
+      std::vector<value_type>& batch = batches[thread_id];
+      for (unsigned x0 = 0; x0 < n_x; x0 += n_batch){
+        const unsigned n_lines = std::min(n_batch, n_x - x0);
+        // first element of the first line of the batch
+        std::array<unsigned,3> first = {0,0,0};
+        first[outer_dim] = outer;
+        first[dim == 0? 1 : 0] = x0;
+        const size_t start = calcIndex(first);
+        const size_t line_step = dim == 0? _size[0] : 1;
+        for (unsigned q = 0; q < n; ++q){
+          for (unsigned l = 0; l < n_lines; ++l){
+            batch[q * n_batch + l] = _values[start + l * line_step + q * stride];
+          }
+        }
+        for (unsigned l = 0; l < n_lines; ++l){
+          bool has_feature_in_reach = false;
+          for (unsigned q = 0; q < n; ++q){
+            buf.line[q] = batch[q * n_batch + l];
+            has_feature_in_reach |= buf.line[q] <= _limit;
+          }
+          // lines without any value up to the limit remain unchanged
+          if (!has_feature_in_reach){continue;}
+          transformLine(buf, n, _limit);
+          for (unsigned q = 0; q < n; ++q){batch[q * n_batch + l] = buf.result[q];}
+        }
+        for (unsigned q = 0; q < n; ++q){
+          for (unsigned l = 0; l < n_lines; ++l){
+            _values[start + l * line_step + q * stride] = batch[q * n_batch + l];
+          }
+        }
+      }
+    });
+}
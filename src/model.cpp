@@ -15,7 +15,7 @@
 // CALCRESULTBUNDLE //
 //////////////////////
 
-std::array<double,3> CalcReportBundle::getCavCentre(const unsigned char i){
+std::array<double,3> CalcReportBundle::getCavCentre(const size_t i){
   std::array<double,3> cav_ctr;
   for (char j = 0; j < 3; ++j){
     cav_ctr[j] = (cavities[i].min_bound[j] + cavities[i].max_bound[j])/2;
@@ -95,6 +95,34 @@ bool Model::setProbeRadii(const double r_1, const double r_2, const bool probe_m
   return true;
 }
 
+void Model::setNumThreads(const unsigned n_threads){
+  _data.n_threads = n_threads;
+}
+
+void Model::setSparseOctree(const bool sparse_octree){
+  _data.sparse_octree = sparse_octree;
+}
+
+void Model::setMemoryBudget(const unsigned long memory_budget){
+  _data.memory_budget = memory_budget;
+}
+
+void Model::setAutoDepth(const bool auto_depth){
+  _data.auto_depth = auto_depth;
+}
+
+void Model::setDistanceTransform(const bool distance_transform){
+  _data.distance_transform = distance_transform;
+}
+
+void Model::setAtomIndex(const mvINDEX atom_index){
+  _data.atom_index = atom_index;
+}
+
+void Model::setPrecision(const mvPRECISION precision){
+  _data.precision = precision;
+}
+
 ///////////////////////
 // CALCULATION ENTRY //
 ///////////////////////
@@ -115,16 +143,20 @@ CalcReportBundle Model::generateData(){
 CalcReportBundle Model::generateVolumeData(){
   prepareVolumeCalc();
   if (!_data.success){return _data;} // if there's been an error during preparation
+  // grids that exceed the memory budget are processed in slabs
+  if (_data.n_slabs > 1){
+    calcSlabVolumes();
+    return _data;
+  }
 
   { // assign each voxel in grid a type
     auto start = std::chrono::steady_clock::now();
-    bool cavities_exceeded = false;
-    _cell.assignTypeInGrid(_atoms, _data.cavities, getProbeRad1(), getProbeRad2(), optionProbeMode(), cavities_exceeded);
+    _cell.assignTypeInGrid(_atoms, _data.cavities, getProbeRad1(), getProbeRad2(), optionProbeMode(), _data.cavities_exceeded);
     if(Ctrl::getInstance()->getAbortFlag()){
       _data.success = false;
       return _data;
     }
-    if(cavities_exceeded){Ctrl::getInstance()->displayErrorMessage(201);}
+    if(_data.cavities_exceeded){Ctrl::getInstance()->displayErrorMessage(201);}
     auto end = std::chrono::steady_clock::now();
     _data.addTime(std::chrono::duration<double>(end-start).count());
   }
@@ -152,6 +184,7 @@ void Model::prepareVolumeCalc(){
   // clear previous results
   _data.volumes.clear();
   _data.cavities.clear();
+  _data.cavities_exceeded = false;
 
   // process atom data for unit cell analysis if the option is ticked
   if(optionAnalyzeUnitCell()){
@@ -166,8 +199,17 @@ void Model::prepareVolumeCalc(){
       _data.analyze_unit_cell ? _processed_atom_coordinates : _raw_atom_coordinates,
       _data.included_elements);
 
+  // predict memory usage and runtime before the grid is allocated
+  const std::array<double,3> exposed_areas = estimateExposedAreas();
+  if(_data.auto_depth){selectDepth(exposed_areas);}
   // set size of the box containing all atoms
   defineCell();
+  _data.estimate = estimateCalculation(exposed_areas);
+  reportEstimate(_data.estimate);
+  if(!planSlabs()){
+    _data.success = false;
+    return;
+  }
 
   // Generate chemical formula and calculate molar mass
   std::map<std::string, int> atom_count;
@@ -197,48 +239,31 @@ CalcReportBundle Model::generateSurfaceData(){
     {0b00001001, 0b00010001},
     {0b00001001} };
 
-  const int total_surfaces = solid_types.size() + 2*_data.cavities.size();
-  auto percentageDone = [](double num, double denom){return int(100*num/denom);};
-
-  // full structure surfaces
-  {
-    std::vector<double> surfaces; // temporary
-    for(size_t i = 0; i < solid_types.size(); ++i){
-      // special case for this set of types, to avoid recalculation
-      if (i == 2 && !optionProbeMode()){
-        surfaces.push_back(surfaces[1]);
-      }
-      else {
-        surfaces.push_back(_cell.calcSurfArea(solid_types[i]));
-      }
-      Ctrl::getInstance()->updateProgressBar(percentageDone(i+1,total_surfaces));
-      // check abort flag
-      if(Ctrl::getInstance()->getAbortFlag()){
-        _data.success = false;
-        return _data;
-      }
-    }
-    // from temporary container to _data
-    _data.surf_vdw = surfaces[0];
-    _data.surf_molecular = surfaces[1];
-    _data.surf_probe_excluded = surfaces[2];
-    _data.surf_probe_accessible = surfaces[3];
+  if (_data.n_slabs > 1){
+    calcSlabSurfaces(solid_types);
+    auto end = std::chrono::steady_clock::now();
+    _data.addTime(std::chrono::duration<double>(end-start).count());
+    return _data;
   }
 
-  // cavity surfaces
-  for (size_t i = 0; i < _data.cavities.size(); ++i){
-    Cavity& cav = _data.cavities[i];
-
-    cav.surf_shell = _cell.calcSurfArea(solid_types[2], cav.id, cav.min_index, cav.max_index);
-    Ctrl::getInstance()->updateProgressBar(percentageDone(solid_types.size() + i*2 + 1,total_surfaces));
-
-    cav.surf_core = _cell.calcSurfArea(solid_types[3], cav.id, cav.min_index, cav.max_index);
-    Ctrl::getInstance()->updateProgressBar(percentageDone(solid_types.size() + i*2 + 2,total_surfaces));
-
-    if(Ctrl::getInstance()->getAbortFlag()){
-      _data.success = false;
-      return _data;
-    }
+  // full structure surfaces and the shell and core surfaces of the cavities in a single pass
+  CavityID max_id = 0;
+  for (const Cavity& cav : _data.cavities){
+    max_id = std::max(max_id, cav.id);
+  }
+  const SurfaceAreas areas = _cell.calcSurfAreas(solid_types, {2, 3}, max_id);
+  if(Ctrl::getInstance()->getAbortFlag()){
+    _data.success = false;
+    return _data;
+  }
+  _data.surf_vdw = areas.total[0];
+  _data.surf_molecular = areas.total[1];
+  // same set of types as the molecular surface
+  _data.surf_probe_excluded = optionProbeMode()? areas.total[2] : areas.total[1];
+  _data.surf_probe_accessible = areas.total[3];
+  for (Cavity& cav : _data.cavities){
+    cav.surf_shell = areas.cavities[0][cav.id];
+    cav.surf_core = areas.cavities[1][cav.id];
   }
 
   auto end = std::chrono::steady_clock::now();
@@ -366,7 +391,12 @@ void Model::defineCell(){
   if(optionAnalyzeUnitCell()){
     unit_cell_limits = {_cart_matrix[0][0], _cart_matrix[1][1], _cart_matrix[2][2]};
   }
-  _cell = Space(_atoms, _data.grid_step, _data.max_depth, optionProbeMode()? getProbeRad2() : getProbeRad1(), optionAnalyzeUnitCell(), unit_cell_limits);
+  // the grid is allocated after checking the memory budget (planSlabs)
+  _cell = Space(_atoms, _data.grid_step, _data.max_depth, optionProbeMode()? getProbeRad2() : getProbeRad1(), optionAnalyzeUnitCell(), unit_cell_limits, _data.sparse_octree, false);
+  _cell.setNumThreads(_data.n_threads);
+  _cell.setDistanceTransform(_data.distance_transform);
+  _cell.setAtomIndex(_data.atom_index);
+  _cell.setPrecision(_data.precision);
   return;
 }
 
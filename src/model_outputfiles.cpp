@@ -16,7 +16,7 @@
 // RESULT REPORT //
 ///////////////////
 
-std::string makeExportFileName(const std::string, const CalcReportBundle&, const char, const unsigned char=0);
+std::string makeExportFileName(const std::string, const CalcReportBundle&, const char, const size_t=0);
 
 int optimalPrecision(const double value);
 
@@ -208,9 +208,9 @@ void Model::createReport(std::string path){
     output_report << "\t// Cavities data //\n";
     output_report << "\t///////////////////\n\n";
 
-    if(_data.cavities.size() >= 255){
+    if(_data.cavities_exceeded){
       output_report << "!!! WARNING !!!\n";
-      output_report << "Maximum number of cavities reached. Some cavities might be missing.\n";
+      output_report << "Too many cavities in a small region of the grid. Some cavities might be incomplete.\n";
       output_report << "To solve this issue, change probe radii (e.g. smaller large probe and/or larger small probe).\n\n";
     }
     output_report << "Note 1:\tSeparate cavities are defined by space accessible to the core of the small probe.\n";
@@ -363,8 +363,12 @@ void Model::writeTotalSurfaceMap(){
 }
 
 void Model::writeTotalSurfaceMap(const std::string file_path){
+  if(_data.n_slabs > 1){
+    Ctrl::getInstance()->displayErrorMessage(304);
+    return;
+  }
   // save commonly used variable
-  std::array<unsigned long int,3> n_elements = _cell.getGrid(0).getNumElements();
+  std::array<unsigned long int,3> n_elements = _cell.getGridstepsOnLvl(0);
   double vxl_length = _cell.getVxlSize();
   std::array<double,3> cell_min = _cell.getMin();
   std::array<double,3> origin;
@@ -406,6 +410,10 @@ void Model::writeCavitiesMaps(){
 }
 
 void Model::writeCavitiesMaps(const std::string file_path){
+  if(_data.n_slabs > 1){
+    Ctrl::getInstance()->displayErrorMessage(304);
+    return;
+  }
   // save commonly used variable
   double vxl_length = _cell.getVxlSize();
   std::array<double,3> cell_min = _cell.getMin();
@@ -415,7 +423,7 @@ void Model::writeCavitiesMaps(const std::string file_path){
 
   // loop over each cavity id
   for(size_t id = 0; id < _data.cavities.size(); id++){
-    std::array<unsigned long int,3> n_elements = _cell.getGrid(0).getNumElements();
+    std::array<unsigned long int,3> n_elements = _cell.getGridstepsOnLvl(0);
     start_index = _data.cavities[id].min_index;
     end_index = _data.cavities[id].max_index;
     // increase size of surface map grid by 1 voxel in each direction to avoid having surfaces on the border of the map
@@ -453,10 +461,8 @@ void Model::writeSurfaceMap(const std::string file_path,
                             std::array<unsigned int,3> start_index,
                             std::array<unsigned int,3> end_index,
                             const bool partial_map,
-                            const unsigned char id){
+                            const size_t id){
   bool issue_encountered = false;
-  // assemble data
-  const Container3D<Voxel>* surface_map = &_cell.getGrid(0);
 
   // create map for assigning numbers to types
   const std::map<char,int> typeToNum =
@@ -508,9 +514,11 @@ void Model::writeSurfaceMap(const std::string file_path,
   for(unsigned long int x = start_index[0]; x < end_index[0]; x++){
     for(unsigned long int y = start_index[1]; y < end_index[1]; y++){
       for(unsigned long int z = start_index[2]; z < end_index[2]; z++){
-        if (typeToNum.count(surface_map->getElement(x,y,z).getType()) != 0){
-          if (partial_map? surface_map->getElement(x,y,z).getID() == _data.cavities[id].id : true){
-            output_file << typeToNum.find(surface_map->getElement(x,y,z).getType())->second;
+        const std::array<unsigned,3> index = {unsigned(x), unsigned(y), unsigned(z)};
+        const Voxel& vxl = _cell.getVxlFromGrid(index,0);
+        if (typeToNum.count(vxl.getType()) != 0){
+          if (partial_map? _cell.getCavityID(index,0) == _data.cavities[id].id : true){
+            output_file << typeToNum.find(vxl.getType())->second;
           }
           else {
             output_file << 0;
@@ -543,12 +551,16 @@ const Container3D<Voxel>& Model::getSurfaceData() const {
   return _cell.getGrid(0);
 }
 
+CavityID Model::getCavityID(const std::array<unsigned,3>& index) const {
+  return _cell.getCavityID(index, 0);
+}
+
 std::array<double,3> Model::getCellOrigin() const {
   return _cell.getOrigin();
 }
 
-const AtomTree& Model::getAtomTree() const {
-  return Voxel::getAtomTree();
+const AtomIndex& Model::getAtomIndex() const {
+  return Voxel::getAtomIndex();
 }
 
 ///////////////
@@ -573,7 +585,7 @@ bool fileExists(const std::string&);
 
 std::string rstripZeros(const std::string str);
 
-std::string makeExportFileName(const std::string dir, const CalcReportBundle& data, const char filetype, const unsigned char n_cav){
+std::string makeExportFileName(const std::string dir, const CalcReportBundle& data, const char filetype, const size_t n_cav){
   assert(s_file_descriptor.count(filetype));
   std::string filename = "";
   filename += fileName(data.atom_file_path);
@@ -0,0 +1,219 @@
+#include "model.h"
+#include "atom.h"
+#include "atomindex.h"
+#include "controller.h"
+#include "misc.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <string>
+#include <vector>
+
+/*
+The memory usage and the runtime of a calculation are predicted before the grid is allocated, so
+that jobs that are too large can be recognised before they run out of memory.
+
+Voxels are only split where they intersect a surface. In the first round of the type assignment,
+these are the van der Waals surface and the probe accessible surface, in the second round the
+molecular surface, which lies between the two. A surface of area A intersects roughly
+sqrt(3)*A/s^2 voxels of side length s. The exposed areas of the surfaces are evaluated once, with
+a set of points on every atom's sphere (Shrake-Rupley algorithm), and are independent of the grid.
+
+From the number of split voxels, the number of voxels that are evaluated on each level and the
+memory of the sparse octree follow. The runtime is a weighted sum of the top level voxels, the voxels
+that are evaluated against atoms, the neighbour searches of the second round, weighted by the
+number of neighbours within the search range, and the stored voxels. In the sparse octree, every
+neighbour is looked up by descending from the top level. The distance transform replaces the
+neighbour searches by a fixed cost per bottom level voxel. The weights have been calibrated on a set
+of structures with a single thread. The prediction is typically within 30 % of the measured
+runtime, but should only be relied on for the order of magnitude.
+*/
+
+namespace {
+  // number of points on each atom's sphere
+  constexpr int s_n_sphere_points = 64;
+  // calibrated weights of the runtime model, in seconds per unit of work
+  constexpr double s_time_per_top_vxl = 1.8e-6;
+  constexpr double s_time_per_atom_eval = 1.0e-6;
+  constexpr double s_time_per_search = 1.3e-8;
+  constexpr double s_time_per_grid_vxl = 5.0e-8;
+  constexpr double s_time_per_surf_vxl = 5.0e-8;
+  // time of the distance transform per bottom level voxel and probe
+  constexpr double s_time_per_dist_vxl = 4.0e-8;
+  // increase of the time per neighbour in the sparse octree for every level below the top level
+  constexpr double s_sparse_lookup_per_lvl = 0.5;
+
+  // points that are evenly distributed on the unit sphere (Fibonacci lattice)
+  std::vector<std::array<double,3>> generateSpherePoints(const int n_points){
+    std::vector<std::array<double,3>> points;
+    const double golden_angle = std::numbers::pi * (3 - std::sqrt(5));
+    for (int i = 0; i < n_points; ++i){
+      const double z = 1 - (2*i + 1)/double(n_points);
+      const double r = std::sqrt(1 - z*z);
+      points.push_back({r * std::cos(golden_angle*i), r * std::sin(golden_angle*i), z});
+    }
+    return points;
+  }
+
+  // area of the surface of the union of all atoms, whose radii are increased by the probe radius
+  double calcExposedArea(const AtomIndex& atom_index, const double r_probe){
+    static const std::vector<std::array<double,3>> s_points = generateSpherePoints(s_n_sphere_points);
+    const std::vector<Atom>& atoms = atom_index.getAtomList();
+    double area = 0;
+    for (size_t i = 0; i < atoms.size(); ++i){
+      const double rad = atoms[i].rad + r_probe;
+      if (rad <= 0){continue;}
+      const Atom::pos_type centre = atoms[i].getPos();
+      // atoms whose spheres intersect the sphere of this atom
+      std::vector<size_t> neighbours = atom_index.listAllWithin(centre, rad + r_probe);
+      std::erase(neighbours, i);
+
+      int n_exposed = 0;
+      for (const std::array<double,3>& point : s_points){
+        Atom::pos_type pos;
+        for (char dim = 0; dim < 3; ++dim){
+          pos[dim] = centre[dim] + rad * point[dim];
+        }
+        n_exposed += std::none_of(neighbours.begin(), neighbours.end(),
+            [&](const size_t j){return distance(atoms[j].getPos(), pos) < atoms[j].rad + r_probe;});
+      }
+      area += 4 * std::numbers::pi * rad * rad * n_exposed / s_n_sphere_points;
+    }
+    return area;
+  }
+
+  // in units of 1024 bytes, like the memory budget
+  std::string formatBytes(const double bytes){
+    char str[32];
+    if (bytes < (1 << 20)){std::snprintf(str, sizeof(str), "%.1f kB", bytes/(1 << 10));}
+    else if (bytes < (1 << 30)){std::snprintf(str, sizeof(str), "%.1f MB", bytes/(1 << 20));}
+    else {std::snprintf(str, sizeof(str), "%.2f GB", bytes/(1 << 30));}
+    return str;
+  }
+}
+
+// exposed areas of the van der Waals surface and the probe accessible surfaces of the small and
+// the large probe. the area of the large probe is zero, if probe mode is off
+std::array<double,3> Model::estimateExposedAreas() const {
+  const std::unique_ptr<AtomIndex> atom_index = AtomIndex::create(_atoms, _data.probe_mode? _data.r_probe2 : _data.r_probe1, _data.atom_index);
+  return {
+    calcExposedArea(*atom_index, 0),
+    calcExposedArea(*atom_index, _data.r_probe1),
+    _data.probe_mode? calcExposedArea(*atom_index, _data.r_probe2) : 0};
+}
+
+// predicts the voxels per level, the memory of the grid and the runtime for the space in _cell,
+// which does not need to be allocated
+CalcEstimate Model::estimateCalculation(const std::array<double,3>& exposed_areas) const {
+  const int depth = _data.max_depth;
+  CalcEstimate estimate;
+  estimate.max_depth = depth;
+  estimate.n_vxl_stored.assign(depth+1, 0);
+  estimate.n_vxl_evaluated.assign(depth+1, 0);
+  std::vector<double> n_split(depth+1, 0);
+
+  double work_atom_eval = 0;
+  double work_search = 0;
+  // the large probe is evaluated first, if probe mode is on
+  std::vector<std::pair<double,double>> probe_areas = {{_data.r_probe1, exposed_areas[1]}};
+  if (_data.probe_mode){probe_areas.push_back({_data.r_probe2, exposed_areas[2]});}
+  for (const auto& [r_probe, area_sas] : probe_areas){
+    const double area_vdw = exposed_areas[0];
+    const double area_ses = (area_vdw + area_sas)/2;
+    // volume between the van der Waals and the probe accessible surface
+    const double vol_shell = area_ses * r_probe;
+    // split voxels on the level above
+    double split_atom_above = 0;
+    double split_shell_above = 0;
+    for (int lvl = depth; lvl >= 0; --lvl){
+      const double n_total = _cell.totalVxlOnLvl(lvl);
+      const double vxl_size = _cell.getVxlSize() * std::pow(2,lvl);
+      const double n_intersect = std::sqrt(3) / (vxl_size*vxl_size);
+      // all top level voxels are evaluated, below only the subvoxels of split voxels
+      const double eval_atom = lvl == depth? n_total : std::min(n_total, 8*split_atom_above);
+      const double eval_shell = lvl == depth?
+        std::min(n_total, vol_shell/std::pow(vxl_size,3) + n_intersect*area_ses) : std::min(n_total, 8*split_shell_above);
+      split_atom_above = lvl == 0? 0 : std::min(eval_atom, n_intersect*(area_vdw + area_sas));
+      split_shell_above = lvl == 0? 0 : std::min(eval_shell, n_intersect*area_ses);
+
+      estimate.n_vxl_evaluated[lvl] += eval_atom + eval_shell;
+      n_split[lvl] += split_atom_above + split_shell_above;
+      work_atom_eval += eval_atom;
+      // the search range is given as the squared distance in units of voxels
+      work_search += eval_shell * std::pow(SearchIndex::calcUppLim(r_probe, _cell.getVxlSize(), lvl), 1.5);
+    }
+  }
+
+  // the dense grids store all voxels, the sparse octree only the subvoxels of split voxels
+  double n_split_total = 0;
+  double work_grid = 0;
+  for (int lvl = depth; lvl >= 0; --lvl){
+    const double n_total = _cell.totalVxlOnLvl(lvl);
+    if (!_data.sparse_octree || lvl == depth){
+      estimate.n_vxl_stored[lvl] = n_total;
+    }
+    else {
+      estimate.n_vxl_stored[lvl] = std::min(n_total, 8*n_split[lvl+1]);
+    }
+    n_split_total += n_split[lvl];
+    work_grid += estimate.n_vxl_stored[lvl];
+  }
+  estimate.grid_bytes = _data.sparse_octree?
+    _cell.estimateSparseMemory(n_split_total) : _cell.estimateGridMemory(_cell.getGridstepsOnLvl(depth)[0]);
+
+  if (_data.sparse_octree){work_search *= 1 + s_sparse_lookup_per_lvl * depth;}
+  // the distance transform replaces the neighbour search in the dense grid
+  double work_dist = 0;
+  if (_data.distance_transform && !_data.sparse_octree){
+    work_search = 0;
+    work_dist = probe_areas.size() * double(_cell.totalVxlOnLvl(0));
+  }
+  // the surface areas are tallied on the bottom level
+  const double work_surf = _data.calc_surface_areas? _cell.totalVxlOnLvl(0) : 0;
+  estimate.runtime = (s_time_per_top_vxl * _cell.totalVxlOnLvl(depth)
+      + s_time_per_atom_eval * work_atom_eval
+      + s_time_per_search * work_search
+      + s_time_per_dist_vxl * work_dist
+      + s_time_per_grid_vxl * work_grid
+      + s_time_per_surf_vxl * work_surf) / std::max(1u, _data.n_threads);
+  return estimate;
+}
+
+// chooses the max depth with the lowest predicted runtime among the depths whose grid fits into
+// the memory budget. if no depth fits, the grid is divided into slabs anyway, so that the lowest
+// runtime is chosen among all depths
+void Model::selectDepth(const std::array<double,3>& exposed_areas){
+  static constexpr int max_depth_limit = 20;
+  const unsigned long budget_bytes = _data.memory_budget << 20;
+  CalcEstimate best;
+  bool best_fits = false;
+  for (int depth = 0; depth <= max_depth_limit; ++depth){
+    _data.max_depth = depth;
+    defineCell();
+    const CalcEstimate estimate = estimateCalculation(exposed_areas);
+    const bool fits = budget_bytes == 0 || estimate.grid_bytes <= budget_bytes;
+    if (depth == 0 || (fits && !best_fits) || (fits == best_fits && estimate.runtime < best.runtime)){
+      best = estimate;
+      best_fits = fits;
+    }
+    // deeper octrees do not reduce the number of top level voxels any further
+    if (_cell.totalVxlOnLvl(depth) == 1){break;}
+  }
+  _data.max_depth = best.max_depth;
+  Ctrl::getInstance()->updateStatus("Selected max depth: " + std::to_string(_data.max_depth));
+}
+
+void Model::reportEstimate(const CalcEstimate& estimate) const {
+  Ctrl::getInstance()->updateStatus("Predicted voxels per level (stored / evaluated):");
+  for (int lvl = estimate.max_depth; lvl >= 0; --lvl){
+    char line[96];
+    std::snprintf(line, sizeof(line), "  level %2d: %12.0f / %12.0f",
+        lvl, estimate.n_vxl_stored[lvl], estimate.n_vxl_evaluated[lvl]);
+    Ctrl::getInstance()->updateStatus(line);
+  }
+  Ctrl::getInstance()->updateStatus("Predicted peak grid memory: " + formatBytes(estimate.grid_bytes));
+  char line[64];
+  std::snprintf(line, sizeof(line), "Predicted runtime: %.2g s", estimate.runtime);
+  Ctrl::getInstance()->updateStatus(line);
+}
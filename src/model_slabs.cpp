@@ -0,0 +1,254 @@
+#include "model.h"
+#include "atom.h"
+#include "controller.h"
+#include "misc.h"
+#include "unionfind.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+Grids that do not fit into the memory budget are divided into slabs along the x-axis, which are
+processed one after another, so that only one slab is held in memory at a time.
+
+Every slab is a box of the grid that spans the whole grid along y and z. It consists of an
+interior, whose results belong to the slab, and a halo on both sides:
+- the inner part of the halo covers the search range of the small probe. it contains all core
+  voxels that the shell voxels of the interior are assigned to. the core voxels of the interior and
+  the inner halo are labelled, i.e., assigned to cavities
+- the outer part of the halo covers the search range of the large probe, so that the shell of the
+  large probe is the same as in the whole grid wherever core voxels are labelled. voxels whose
+  neighbour search would reach past the edge of the box are left unassigned
+The interiors of all slabs cover the grid without overlap, so that volumes and surfaces are
+tallied once. The cavities of neighbouring slabs are joined through the core voxels that both
+slabs label (seam voxels). Afterwards, the cavities are numbered in the order of the scan through
+the whole grid, so that the cavity IDs are the same as without slabs.
+
+The surfaces of a cavity can only be evaluated with its final ID, since cavities that are separate
+in one slab may be joined through another slab. Therefore, the slabs are calculated a second time
+for the surface areas.
+*/
+
+////////////////
+// SLAB SETUP //
+////////////////
+
+// allocates the grid if it fits into the memory budget. otherwise, the grid is divided into slabs
+bool Model::planSlabs(){
+  _slabs.clear();
+  _data.n_slabs = 1;
+  const unsigned long n_top_x = _cell.getGridsteps()[0];
+  const size_t budget = size_t(_data.memory_budget) << 20;
+  if (_data.memory_budget == 0 || optionAnalyzeUnitCell() || _cell.estimateGridMemory(n_top_x) <= budget){
+    _cell.allocateGrid();
+    return true;
+  }
+
+  // the shell voxels of the interior are assigned to core voxels within the search range of the
+  // small probe. the neighbours of the labelled core voxels are read to find the cavities
+  const unsigned long label_margin = _cell.calcSearchReach(getProbeRad1()) + 1;
+  // in the probe mode, the core voxels of the small probe depend on the shell of the large probe
+  const unsigned long type_margin = optionProbeMode()? _cell.calcSearchReach(getProbeRad2()) : 1;
+  const unsigned long halo = label_margin + type_margin;
+
+  const unsigned long n_top_x_budget = budget / _cell.estimateGridMemory(1);
+  if (n_top_x_budget <= 2*halo){
+    Ctrl::getInstance()->displayErrorMessage(202);
+    return false;
+  }
+  const unsigned long width = n_top_x_budget - 2*halo;
+  for (unsigned long first = 0; first < n_top_x; first += width){
+    const unsigned long end = std::min(first + width, n_top_x);
+    auto extend = [&](const unsigned long margin){
+      return std::array<unsigned long,2>{first - std::min(first, margin), std::min(end + margin, n_top_x)};
+    };
+    _slabs.push_back({extend(halo), extend(label_margin), {first, end}, {}});
+  }
+  _data.n_slabs = _slabs.size();
+  return true;
+}
+
+// returns the atoms that can reach into the box of a slab. the margin includes the radius of the
+// top level voxels, which are compared to the atoms as a whole
+std::vector<Atom> Model::listAtomsNearSlab(const Slab& slab) const {
+  const double top_vxl_size = _data.grid_step * pow2(_data.max_depth);
+  const double reach = _max_atom_radius + (_data.probe_mode? _data.r_probe2 : _data.r_probe1) + 2*top_vxl_size;
+  const double x_min = _cell.getOrigin()[0] + slab.box[0] * top_vxl_size - reach;
+  const double x_max = _cell.getOrigin()[0] + slab.box[1] * top_vxl_size + reach;
+  std::vector<Atom> slab_atoms;
+  for (const Atom& atom : _atoms){
+    if (atom.getPos()[0] >= x_min && atom.getPos()[0] <= x_max){
+      slab_atoms.push_back(atom);
+    }
+  }
+  return slab_atoms;
+}
+
+/////////////
+// VOLUMES //
+/////////////
+
+void Model::calcSlabVolumes(){
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::vector<Cavity>> slab_cavities(_slabs.size());
+  std::vector<SlabLabels> slab_labels(_slabs.size());
+  std::vector<SeamVoxel> seam;
+  for (size_t k = 0; k < _slabs.size(); ++k){
+    Ctrl::getInstance()->updateStatus("Slab " + std::to_string(k+1) + " of " + std::to_string(_slabs.size()) + ":");
+    std::vector<Atom> slab_atoms = listAtomsNearSlab(_slabs[k]);
+    Space slab(_cell, _slabs[k].box, _slabs[k].labelled, _slabs[k].interior);
+    slab.getSlabLabels().lower_seam = std::move(seam);
+    bool cavities_exceeded = false;
+    slab.assignTypeInGrid(slab_atoms, slab_cavities[k], getProbeRad1(), getProbeRad2(), optionProbeMode(), cavities_exceeded);
+    if(Ctrl::getInstance()->getAbortFlag()){
+      _data.success = false;
+      return;
+    }
+    _data.cavities_exceeded |= cavities_exceeded;
+
+    std::map<char,double> volumes;
+    slab.sumVolume(volumes, slab_cavities[k], false);
+    for (const auto& [type, volume] : volumes){
+      _data.volumes[type] += volume;
+    }
+    seam = std::move(slab.getSlabLabels().upper_seam);
+    slab_labels[k] = std::move(slab.getSlabLabels());
+  }
+  if(_data.cavities_exceeded){Ctrl::getInstance()->displayErrorMessage(201);}
+
+  stitchSlabCavities(slab_cavities, slab_labels);
+  // sort cavities by volume from largest to smallest
+  inverseSort(_data.cavities);
+  auto end = std::chrono::steady_clock::now();
+  _data.addTime(std::chrono::duration<double>(end-start).count());
+}
+
+// joins the cavities and entrances of all slabs and assigns the IDs of the whole grid
+void Model::stitchSlabCavities(const std::vector<std::vector<Cavity>>& slab_cavities, const std::vector<SlabLabels>& slab_labels){
+  // the cavities and entrances of all slabs are numbered consecutively
+  std::vector<size_t> cavity_offset(_slabs.size()+1, 0);
+  std::vector<size_t> entrance_offset(_slabs.size()+1, 0);
+  for (size_t k = 0; k < _slabs.size(); ++k){
+    cavity_offset[k+1] = cavity_offset[k] + slab_cavities[k].size();
+    entrance_offset[k+1] = entrance_offset[k] + slab_labels[k].entrances.size();
+  }
+  UnionFind cavity_sets(cavity_offset.back());
+  UnionFind entrance_sets(entrance_offset.back());
+  for (size_t k = 1; k < _slabs.size(); ++k){
+    for (const auto& [prev, cur] : slab_labels[k].cavity_links){
+      cavity_sets.unite(cavity_offset[k-1] + prev-1, cavity_offset[k] + cur-1);
+    }
+    for (const auto& [prev, cur] : slab_labels[k].entrance_links){
+      entrance_sets.unite(entrance_offset[k-1] + prev-1, entrance_offset[k] + cur-1);
+    }
+  }
+
+  // cavities are numbered in the order of their first voxel in the interior of a slab
+  std::vector<CavityID> root_id(cavity_offset.back(), 0);
+  CavityID id = 0;
+  for (size_t k = 0; k < _slabs.size(); ++k){
+    for (CavityID label = 1; label <= slab_labels[k].n_interior_cavities; ++label){
+      const size_t root = cavity_sets.find(cavity_offset[k] + label-1);
+      if (root_id[root] == 0){
+        root_id[root] = ++id;
+        _data.cavities.push_back(Cavity(id, 0));
+      }
+    }
+  }
+  for (size_t k = 0; k < _slabs.size(); ++k){
+    _slabs[k].stitched_ids.assign(slab_cavities[k].size()+1, 0);
+    for (CavityID label = 1; label <= slab_cavities[k].size(); ++label){
+      _slabs[k].stitched_ids[label] = root_id[cavity_sets.find(cavity_offset[k] + label-1)];
+    }
+  }
+
+  // sum the volumes and combine the bounds of the parts of each cavity. the volumes are summed in
+  // units of bottom level voxels, so that they are exactly the same as in the whole grid
+  const double unit_volume = std::pow(_cell.getVxlSize(), 3);
+  std::vector<bool> has_bounds(_data.cavities.size(), false);
+  for (size_t k = 0; k < _slabs.size(); ++k){
+    const unsigned bot_lvl_offset = _slabs[k].box[0] << _data.max_depth;
+    for (const Cavity& part : slab_cavities[k]){
+      // parts without voxels in the interior have not been tallied
+      const CavityID stitched_id = _slabs[k].stitched_ids[part.id];
+      if (part.getVolume() == 0 || stitched_id == 0){continue;}
+      Cavity& cav = _data.cavities[stitched_id-1];
+      cav.core_vol += std::round(part.core_vol/unit_volume);
+      cav.shell_vol += std::round(part.shell_vol/unit_volume);
+      std::array<unsigned,3> min_index = part.min_index;
+      std::array<unsigned,3> max_index = part.max_index;
+      min_index[0] += bot_lvl_offset;
+      max_index[0] += bot_lvl_offset;
+      for (char i = 0; i < 3; ++i){
+        if (!has_bounds[stitched_id-1] || min_index[i] < cav.min_index[i]){cav.min_index[i] = min_index[i];}
+        if (!has_bounds[stitched_id-1] || max_index[i] > cav.max_index[i]){cav.max_index[i] = max_index[i];}
+      }
+      has_bounds[stitched_id-1] = true;
+    }
+  }
+  for (Cavity& cav : _data.cavities){
+    cav.core_vol *= unit_volume;
+    cav.shell_vol *= unit_volume;
+    for (char i = 0; i < 3; ++i){
+      cav.min_bound[i] = _cell.getOrigin()[i] + _cell.getVxlSize()*cav.min_index[i];
+      cav.max_bound[i] = _cell.getOrigin()[i] + _cell.getVxlSize()*(cav.max_index[i]+1);
+    }
+  }
+
+  // count the entrances of each cavity that have a voxel in the interior of any slab
+  std::set<std::pair<CavityID,size_t>> entrances;
+  for (size_t k = 0; k < _slabs.size(); ++k){
+    for (size_t i = 0; i < slab_labels[k].entrances.size(); ++i){
+      const SlabLabels::Entrance& entrance = slab_labels[k].entrances[i];
+      const CavityID stitched_id = _slabs[k].stitched_ids[entrance.cavity];
+      if (!entrance.interior || stitched_id == 0){continue;}
+      entrances.insert({stitched_id, entrance_sets.find(entrance_offset[k] + i)});
+    }
+  }
+  for (const auto& [stitched_id, entrance] : entrances){
+    _data.cavities[stitched_id-1].n_entrances++;
+  }
+}
+
+//////////////
+// SURFACES //
+//////////////
+
+void Model::calcSlabSurfaces(const std::vector<std::vector<char>>& solid_types){
+  std::vector<double> surfaces(solid_types.size(), 0);
+  for (size_t k = 0; k < _slabs.size(); ++k){
+    Ctrl::getInstance()->updateStatus("Slab " + std::to_string(k+1) + " of " + std::to_string(_slabs.size()) + ":");
+    std::vector<Atom> slab_atoms = listAtomsNearSlab(_slabs[k]);
+    Space slab(_cell, _slabs[k].box, _slabs[k].labelled, _slabs[k].interior);
+    std::vector<Cavity> slab_cavities;
+    bool cavities_exceeded = false;
+    slab.assignTypeInGrid(slab_atoms, slab_cavities, getProbeRad1(), getProbeRad2(), optionProbeMode(), cavities_exceeded);
+    if(Ctrl::getInstance()->getAbortFlag()){
+      _data.success = false;
+      return;
+    }
+    slab.setStitchedCavityIDs(_slabs[k].stitched_ids);
+
+    // the marching cubes that start in the interior of the slab, with the cavity IDs of the whole grid
+    Ctrl::getInstance()->updateStatus("Calculating surface areas...");
+    const SurfaceAreas areas = slab.calcSurfAreas(solid_types, {2, 3}, _data.cavities.size());
+    for (size_t i = 0; i < solid_types.size(); ++i){
+      surfaces[i] += areas.total[i];
+    }
+    for (Cavity& cav : _data.cavities){
+      cav.surf_shell += areas.cavities[0][cav.id];
+      cav.surf_core += areas.cavities[1][cav.id];
+    }
+    if(Ctrl::getInstance()->getAbortFlag()){
+      _data.success = false;
+      return;
+    }
+  }
+  _data.surf_vdw = surfaces[0];
+  _data.surf_molecular = surfaces[1];
+  _data.surf_probe_excluded = optionProbeMode()? surfaces[2] : surfaces[1];
+  _data.surf_probe_accessible = surfaces[3];
+}
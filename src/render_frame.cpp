@@ -85,7 +85,7 @@ RenderFrame::~RenderFrame()
 ////////////////////
 
 void RenderFrame::UpdateSurface(const Container3D<Voxel>& surf_data, const std::array<double,3> origin, 
-    const double grid_step, const bool probe_mode, const unsigned char n_cavities){
+    const double grid_step, const bool probe_mode, const size_t n_cavities){
   // Set up image
   std::array<unsigned long,3> dims = surf_data.getNumElements();
 
@@ -162,8 +162,9 @@ void RenderFrame::UpdateMolecule(const std::vector<Atom>& atomlist) {
     const Atom& at = all_atoms[at_id];
     std::vector<size_t> closest = atomtree.listAllWithin(at.getPos(), 0);
 
+    // every bond is found from both of its atoms, but only added once
     for (const size_t nb_id : closest) {
-      if (nb_id != at_id) {
+      if (nb_id > at_id) {
         molecule->AppendBond(atom_objs[at_id], atom_objs[nb_id], 1);
       }
     }
@@ -440,7 +441,7 @@ void RenderFrame::OnCavitySelect(wxCommandEvent& event) {
   // Get a vector of selected cavity IDs
   wxArrayInt selection;
   int n_selections = m_cavityList->GetSelections(selection);
-  std::vector<unsigned char> idx_list;
+  std::vector<CavityID> idx_list;
   for (size_t i = 0; i < n_selections; ++i) {
     idx_list.push_back(selection.Item(i));
   }
@@ -471,7 +472,7 @@ void RenderFrame::OnCavitySelect(wxCommandEvent& event) {
         for (size_t k = 0; k < dims[2]; ++k) {
           unsigned char* voxel = static_cast<unsigned char*>(maskdata->GetScalarPointer(i,j,k));
           *voxel = (unsigned char)(
-              std::binary_search(idx_list.begin(), idx_list.end(), surf_data.getElement(i,j,k).getID())? 1 : 0
+              std::binary_search(idx_list.begin(), idx_list.end(), m_parentWindow->getCavityID({unsigned(i), unsigned(j), unsigned(k)}))? 1 : 0
             );
         }
       }
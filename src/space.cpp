@@ -5,20 +5,42 @@
 #include "misc.h"
 #include "exception.h"
 #include "controller.h"
+#include "threadpool.h"
+#include "unionfind.h"
 #include <cmath>
 #include <cassert>
 #include <stdexcept>
 #include <algorithm> // find
 #include <numeric> // accumulate
+#include <memory> // make_shared
+#include <bit> // countr_zero
 
 /////////////////
 // CONSTRUCTOR //
 /////////////////
 
-Space::Space(std::vector<Atom> &atoms, const double bot_lvl_vxl_dist, const int depth, const double r_probe, const bool unit_cell_option, const std::array<double,3> unit_cell_axes)
-  :_grid_size(bot_lvl_vxl_dist), _max_depth(depth), _unit_cell_limits(unit_cell_axes), _unit_cell(unit_cell_option){
+Space::Space(std::vector<Atom> &atoms, const double bot_lvl_vxl_dist, const int depth, const double r_probe, const bool unit_cell_option, const std::array<double,3> unit_cell_axes, const bool sparse, const bool allocate_grid)
+  :_grid_size(bot_lvl_vxl_dist), _max_depth(depth), _unit_cell_limits(unit_cell_axes), _unit_cell(unit_cell_option), _sparse(sparse){
   setBoundaries(atoms,r_probe+2*bot_lvl_vxl_dist);
+  _grid_origin = _cart_min;
   initGrid();
+  if (allocate_grid){allocateGrid();}
+}
+
+Space::Space(const Space& parent, const std::array<unsigned long,2>& box, const std::array<unsigned long,2>& labelled, const std::array<unsigned long,2>& interior)
+  :_cart_min(parent._cart_min), _cart_max(parent._cart_max), _n_top_lvl_vxl(parent._n_top_lvl_vxl),
+   _grid_size(parent._grid_size), _max_depth(parent._max_depth), _unit_cell(false), _sparse(parent._sparse),
+   _n_threads(parent._n_threads), _distance_transform(parent._distance_transform), _atom_index(parent._atom_index),
+   _precision(parent._precision), _slab(true),
+   _grid_origin(parent._grid_origin), _slab_offset(box[0]){
+  const double top_vxl_size = _grid_size * pow2(_max_depth);
+  _cart_min[0] = _grid_origin[0] + box[0] * top_vxl_size;
+  _cart_max[0] = _grid_origin[0] + box[1] * top_vxl_size;
+  _n_top_lvl_vxl[0] = box[1] - box[0];
+  _slab_at_grid_end = box[1] == parent._n_top_lvl_vxl[0];
+  _labelled_top_x = {labelled[0] - box[0], labelled[1] - box[0]};
+  _interior_top_x = {interior[0] - box[0], interior[1] - box[0]};
+  allocateGrid();
 }
 
 ///////////////////////////////
@@ -83,107 +105,432 @@ void Space::setBoundaries(const std::vector<Atom> &atoms, const double add_space
   return;
 }
 
-// based on the grid step and the octree _max_depth, this function produces a
-// 3D grid (in form of a 1D vector) that contains all top level voxels.
+// based on the grid step and the octree _max_depth, this function determines the
+// number of top level voxels that are needed to cover the space
 void Space::initGrid(){
-  _grid.clear();
   // determine how many top lvl voxels in each direction are needed
-  std::array<unsigned long,3> n_top_lvl_vxl;
   for (int dim = 0; dim < 3; dim++){
-    n_top_lvl_vxl[dim] = std::ceil (std::ceil( (getSize())[dim] / _grid_size ) / std::pow(2,_max_depth) );
+    _n_top_lvl_vxl[dim] = std::ceil (std::ceil( (getSize())[dim] / _grid_size ) / std::pow(2,_max_depth) );
+  }
+  _labelled_top_x = {0, _n_top_lvl_vxl[0]};
+  _interior_top_x = {0, _n_top_lvl_vxl[0]};
+}
+
+// produces a 3D grid (in form of a 1D vector) for each level of the octree
+void Space::allocateGrid(){
+  _grid.clear();
+  // a palette of cavity IDs covers whole top level voxels and at least 16 bottom level voxels in
+  // each direction, so that there are few palettes compared to the number of voxels
+  _palette_lvl = std::max(_max_depth, 4);
+  for (int dim = 0; dim < 3; dim++){
+    _n_palette_blocks[dim] = ((_n_top_lvl_vxl[dim] << _max_depth) + (1ul << _palette_lvl) - 1) >> _palette_lvl;
+  }
+  _id_palettes = std::vector<IDPalette>(_n_palette_blocks[0] * _n_palette_blocks[1] * _n_palette_blocks[2]);
+  // in the sparse mode, subvoxels are only allocated when a voxel is split
+  if (_sparse){
+    _sparse_grid = SparseOctree(_n_top_lvl_vxl, _max_depth);
+    return;
   }
   // initialise 3d tensors for each octree level
   for (int lvl = 0; lvl <= _max_depth; ++lvl){
-    _grid.push_back(Container3D<Voxel>( n_top_lvl_vxl[0]*pow(2,_max_depth-lvl),
-                                        n_top_lvl_vxl[1]*pow(2,_max_depth-lvl),
-                                        n_top_lvl_vxl[2]*pow(2,_max_depth-lvl)));
+    _grid.push_back(Container3D<Voxel,GridLayout>(getGridstepsOnLvl(lvl)));
+  }
+}
+
+// returns the approximate memory in bytes of the dense grids for a box of the space that
+// contains n_top_x top level voxels along x
+size_t Space::estimateGridMemory(const unsigned long n_top_x) const {
+  size_t n_vxl_per_top = 0;
+  for (int lvl = 0; lvl <= _max_depth; ++lvl){
+    n_vxl_per_top += size_t(1) << (3*lvl);
+  }
+  size_t bytes = n_top_x * _n_top_lvl_vxl[1] * _n_top_lvl_vxl[2] * n_vxl_per_top * sizeof(Voxel);
+  // the distance transform holds one value per bottom level voxel during the type assignment
+  if (_distance_transform && !_sparse){
+    bytes += DistanceTransform::estimateMemory((n_top_x * _n_top_lvl_vxl[1] * _n_top_lvl_vxl[2]) << (3*_max_depth));
   }
+  return bytes;
+}
+
+// memory of the sparse octree, if a number of voxels below the top level are split
+size_t Space::estimateSparseMemory(const size_t n_split) const {
+  return SparseOctree::estimateMemory(totalVxlOnLvl(_max_depth), n_split);
 }
 
 /////////////////////
 // TYPE ASSIGNMENT //
 /////////////////////
 
+// returns a callback for ThreadPool that updates the progress bar and checks for an abort
+// signal. the progress bar is only updated when the percentage changes
+ThreadPool::progress_type Space::makeProgressReporter(const size_t n_total){
+  auto last_percentage = std::make_shared<int>(-1);
+  return [n_total, last_percentage](const size_t n_done){
+    Ctrl::getInstance()->updateCalculationStatus();
+    const int percentage = int(100*double(n_done)/double(n_total));
+    if (percentage != *last_percentage){
+      *last_percentage = percentage;
+      Ctrl::getInstance()->updateProgressBar(percentage);
+    }
+  };
+}
+
+void Space::setNumThreads(const unsigned n_threads){
+  _n_threads = ThreadPool::validateNumThreads(n_threads);
+}
+
+// the distance transform is only used for the dense grid
+void Space::setDistanceTransform(const bool distance_transform){
+  _distance_transform = distance_transform;
+}
+
+void Space::setAtomIndex(const mvINDEX atom_index){
+  _atom_index = atom_index;
+}
+
+void Space::setPrecision(const mvPRECISION precision){
+  _precision = precision;
+}
+
+unsigned Space::getNumThreads() const {
+  return _n_threads;
+}
+
 // sets all voxel's types, determined by the input atoms
 void Space::assignTypeInGrid(std::vector<Atom>& atomlist, std::vector<Cavity>& cavities, const double r_probe1, const double r_probe2, bool probe_mode, bool& cavities_exceeded){
   // save variable that all voxels need access to for their type determination as static members of Voxel class
-  Voxel::prepareTypeAssignment(this, atomlist);
+  Voxel::prepareTypeAssignment(this, atomlist, probe_mode? std::max(r_probe1, r_probe2) : r_probe1, _atom_index, _precision);
+  // the passes are compiled separately for both probes, so that the types that they assign are
+  // constants (see ProbeTypes)
   if (probe_mode){
     // first run algorithm with the larger probe to exclude most voxels - "masking mode"
-    Voxel::storeProbe(r_probe2, true);
+    Voxel::storeProbe(r_probe2);
     Ctrl::getInstance()->updateStatus("Blocking off cavities with large probe...");
-    assignAtomVsCore();
-    assignShellVsVoid();
+    assignAtomVsCore<true>();
+    assignShellVsVoid<true>();
   }
 
   Ctrl::getInstance()->updateStatus(std::string("Probing space") + (probe_mode? " with small probe..." : "..."));
-  Voxel::storeProbe(r_probe1, false);
-  assignAtomVsCore();
+  Voxel::storeProbe(r_probe1);
+  assignAtomVsCore<false>();
 
   Ctrl::getInstance()->updateStatus("Identifying cavities...");
-  try{identifyCavities(cavities, probe_mode);}
-  catch (const std::overflow_error& e){cavities_exceeded = true;}
+  identifyCavities(cavities, probe_mode);
 
   Ctrl::getInstance()->updateStatus("Searching inaccessible areas...");
-  assignShellVsVoid();
+  assignShellVsVoid<false>();
+
+  cavities_exceeded = std::any_of(_id_palettes.begin(), _id_palettes.end(),
+      [](const IDPalette& palette){return palette.overflow;});
 }
 
+template<bool t_masking_mode>
 void Space::assignAtomVsCore(){
   if (Ctrl::getInstance()->getAbortFlag()){return;}
-  // calculate position of first voxel
-  const std::array<double,3> vxl_origin = getOrigin();
+  // calculate position of first voxel. the voxels of a slab are positioned relative to the origin
+  // of the whole grid, so that their positions are exactly the same as in the whole grid
+  const std::array<double,3> vxl_origin = _grid_origin;
+  const std::array<unsigned long,3> top_lvl_offset = {_slab_offset, 0, 0};
   // calculate side length of top level voxel
   const double vxl_dist = _grid_size * pow(2,_max_depth);
-  std::array<double,3> vxl_pos;
-  std::array<unsigned,3> top_lvl_index;
-  for(top_lvl_index[0] = 0; top_lvl_index[0] < getGridsteps()[0]; top_lvl_index[0]++){
-    Ctrl::getInstance()->updateCalculationStatus();
-    vxl_pos[0] = vxl_origin[0] + vxl_dist * (0.5 + top_lvl_index[0]);
-    for(top_lvl_index[1] = 0; top_lvl_index[1] < getGridsteps()[1]; top_lvl_index[1]++){
-      vxl_pos[1] = vxl_origin[1] + vxl_dist * (0.5 + top_lvl_index[1]);
-      for(top_lvl_index[2] = 0; top_lvl_index[2] < getGridsteps()[2]; top_lvl_index[2]++){
-        vxl_pos[2] = vxl_origin[2] + vxl_dist * (0.5 + top_lvl_index[2]);
-        // voxel position is deliberately not stored in voxel object to reduce memory cost
-        if (Ctrl::getInstance()->getAbortFlag()){return;}
-        getTopVxl(top_lvl_index).evalRelationToAtoms(top_lvl_index, vxl_pos, _max_depth);
+  // top level voxels are independent of each other, since every voxel only writes to itself
+  // and its own subvoxels. they are distributed among threads in the same x-y-z order as
+  // the serial loop
+  ThreadPool pool(_n_threads);
+  // visited nodes or cells of the atom index, counted per thread
+  std::vector<unsigned long> node_visits(pool.getNumThreads(), 0);
+  pool.parallelFor(totalVxlOnLvl(_max_depth),
+    [&](const size_t i, const unsigned thread_id){
+      if (Ctrl::getInstance()->getAbortFlag()){return;}
+      std::array<unsigned,3> top_lvl_index = calcTopIndex(i);
+      // voxel position is deliberately not stored in voxel object to reduce memory cost
+      std::array<double,3> vxl_pos;
+      for (char dim = 0; dim < 3; ++dim){
+        vxl_pos[dim] = vxl_origin[dim] + vxl_dist * (0.5 + (top_lvl_index[dim] + top_lvl_offset[dim]));
       }
-    }
-    Ctrl::getInstance()->updateProgressBar(int(100*(double(top_lvl_index[0])+1)/double(getGridsteps()[0])));
-  }
+      getTopVxl(top_lvl_index).evalRelationToAtoms<t_masking_mode>(top_lvl_index, vxl_pos, _max_depth);
+      node_visits[thread_id] += Voxel::takeNodeVisits();
+    },
+    makeProgressReporter(totalVxlOnLvl(_max_depth)));
+  Ctrl::getInstance()->updateStatus("Visited " + Voxel::getAtomIndex().getName() + " nodes or cells: "
+      + std::to_string(std::accumulate(node_visits.begin(), node_visits.end(), 0ul)));
 }
 
+// cavities are the connected components of pure small probe core voxels. they are labelled with
+// a concurrent union-find: every core voxel is merged with its core neighbours, which can happen
+// in any order and on any number of threads. the core voxels are numbered in the order of a scan
+// through the top level voxels in x-y-z order and a depth first traversal of their subvoxels.
+// since the root of every set is its smallest element, the first voxel of each cavity in this
+// scan is the root of its set and the cavity IDs are assigned in the order of the scan.
+// a slab only labels the core voxels in its labelled range, where the types are the same as in
+// the whole grid, and numbers the cavities in the order of their first voxel in its interior
 void Space::identifyCavities(std::vector<Cavity>& cavities, const bool cavity_types){
   if (Ctrl::getInstance()->getAbortFlag()){return;}
-  std::array<unsigned int,3> vxl_index;
-  unsigned char id = 1;
-  for(vxl_index[0] = 0; vxl_index[0] < getGridsteps()[0]; vxl_index[0]++){
-    for(vxl_index[1] = 0; vxl_index[1] < getGridsteps()[1]; vxl_index[1]++){
-      for(vxl_index[2] = 0; vxl_index[2] < getGridsteps()[2]; vxl_index[2]++){
+  ThreadPool pool(_n_threads);
+  const ThreadPool::progress_type check_status = [](const size_t){Ctrl::getInstance()->updateCalculationStatus();};
+
+  // list the pure core voxels of every top level voxel in scan order
+  const size_t n_top = totalVxlOnLvl(_max_depth);
+  std::vector<std::vector<VoxelLoc>> core_vxls_per_top(n_top);
+  pool.parallelFor(n_top,
+    [&](const size_t i, const unsigned){
+      if (Ctrl::getInstance()->getAbortFlag()){return;}
+      const std::array<unsigned,3> top_index = calcTopIndex(i);
+      if (top_index[0] < _labelled_top_x[0] || top_index[0] >= _labelled_top_x[1]){return;}
+      listCoreVoxels(core_vxls_per_top[i], top_index, _max_depth);
+    },
+    check_status);
+  if (Ctrl::getInstance()->getAbortFlag()){return;}
+
+  // the core voxels of a top level voxel occupy a contiguous range in the list of all core voxels
+  std::vector<size_t> top_offset(n_top+1, 0);
+  for (size_t i = 0; i < n_top; ++i){
+    top_offset[i+1] = top_offset[i] + core_vxls_per_top[i].size();
+  }
+  const size_t n_core = top_offset[n_top];
+  std::vector<VoxelLoc> core_vxls;
+  core_vxls.reserve(n_core);
+  for (std::vector<VoxelLoc>& top_core_vxls : core_vxls_per_top){
+    core_vxls.insert(core_vxls.end(), top_core_vxls.begin(), top_core_vxls.end());
+    std::vector<VoxelLoc>().swap(top_core_vxls);
+  }
+  std::vector<unsigned long long> scan_keys(n_core);
+  for (size_t i = 0; i < n_core; ++i){
+    scan_keys[i] = calcScanKey(core_vxls[i]);
+  }
+  // returns the position of a pure core voxel in the list of all core voxels, or n_core if the
+  // voxel is not in the list
+  auto find_core_vxl = [&](const VoxelLoc& loc){
+    const size_t top = calcTopPosition(loc);
+    const auto first = scan_keys.begin() + top_offset[top];
+    const auto last = scan_keys.begin() + top_offset[top+1];
+    const auto it = std::lower_bound(first, last, calcScanKey(loc));
+    return (it != last && *it == calcScanKey(loc))? size_t(it - scan_keys.begin()) : n_core;
+  };
+
+  // core voxels at the interface to the outside of the large probe are grouped into entrances
+  std::vector<char> interface_vxl(cavity_types? n_core : 0, false);
+  if (cavity_types){
+    pool.parallelFor(n_core,
+      [&](const size_t i, const unsigned){
         if (Ctrl::getInstance()->getAbortFlag()){return;}
-        try{
-          descendToCore(cavities, id,vxl_index,getMaxDepth(),cavity_types); // id gets iterated inside this function
+        interface_vxl[i] = getVxlFromGrid(core_vxls[i].index, core_vxls[i].lvl).isInterfaceVxl(core_vxls[i]);
+      },
+      check_status);
+    if (Ctrl::getInstance()->getAbortFlag()){return;}
+  }
+
+  // merge every core voxel with its core neighbours. voxels are only read in this step
+  UnionFind cavity_sets(n_core);
+  UnionFind entrance_sets(cavity_types? n_core : 0);
+  std::vector<std::vector<VoxelLoc>> nb_buffers(pool.getNumThreads());
+  pool.parallelFor(n_core,
+    [&](const size_t i, const unsigned thread_id){
+      if (Ctrl::getInstance()->getAbortFlag()){return;}
+      std::vector<VoxelLoc>& core_nbs = nb_buffers[thread_id];
+      core_nbs.clear();
+      getVxlFromGrid(core_vxls[i].index, core_vxls[i].lvl).findCoreNeighbours(core_nbs, core_vxls[i]);
+      for (const VoxelLoc& nb : core_nbs){
+        if (!isInSlabRange(nb, _labelled_top_x)){continue;}
+        const size_t j = find_core_vxl(nb);
+        assert(j != n_core);
+        cavity_sets.unite(i, j);
+        if (cavity_types && interface_vxl[i] && interface_vxl[j]){
+          entrance_sets.unite(i, j);
         }
-        catch (const std::overflow_error& e){
-          throw;
+      }
+    },
+    makeProgressReporter(n_core));
+  if (Ctrl::getInstance()->getAbortFlag()){return;}
+
+  // every connected group of interface voxels is one entrance of the cavity it belongs to
+  std::vector<int> n_entrances(cavity_types? n_core : 0, 0);
+  for (size_t i = 0; i < entrance_sets.size(); ++i){
+    if (interface_vxl[i] && entrance_sets.isRoot(i)){
+      n_entrances[cavity_sets.find(i)]++;
+    }
+  }
+
+  // compaction: assign IDs to the cavities in scan order. outside of a slab, every voxel is in
+  // the interior and the first voxel of each cavity is the root of its set
+  std::vector<CavityID> root_id(n_core, 0);
+  CavityID id = 0;
+  auto assign_id = [&](const size_t i){
+    const size_t root = cavity_sets.find(i);
+    if (root_id[root] != 0){return;}
+    root_id[root] = ++id;
+    cavities.push_back(Cavity(id, cavity_types? n_entrances[root] : 0));
+  };
+  for (size_t i = 0; i < n_core; ++i){
+    if (isInSlabRange(core_vxls[i], _interior_top_x)){assign_id(i);}
+  }
+  _slab_labels.n_interior_cavities = id;
+  for (size_t i = 0; i < n_core; ++i){
+    if (!isInSlabRange(core_vxls[i], _interior_top_x)){assign_id(i);}
+  }
+
+  // the palettes are filled in scan order, so that the local IDs do not depend on the threads
+  std::vector<unsigned char> local_id(n_core);
+  for (size_t i = 0; i < n_core; ++i){
+    local_id[i] = findLocalID(root_id[cavity_sets.find(i)], core_vxls[i].index, core_vxls[i].lvl);
+  }
+
+  pool.parallelFor(n_core,
+    [&](const size_t i, const unsigned){
+      Voxel& vxl = getVxlFromGrid(core_vxls[i].index, core_vxls[i].lvl);
+      vxl.setLocalID(local_id[i]);
+    },
+    check_status);
+  if (!_slab){return;}
+
+  // entrances are labelled in scan order
+  std::vector<CavityID> entrance_label(cavity_types? n_core : 0, 0);
+  _slab_labels.entrances.clear();
+  for (size_t i = 0; i < entrance_sets.size(); ++i){
+    if (interface_vxl[i] && entrance_sets.isRoot(i)){
+      entrance_label[i] = _slab_labels.entrances.size() + 1;
+      _slab_labels.entrances.push_back({root_id[cavity_sets.find(i)], false});
+    }
+  }
+  for (size_t i = 0; i < entrance_sets.size(); ++i){
+    if (interface_vxl[i] && isInSlabRange(core_vxls[i], _interior_top_x)){
+      _slab_labels.entrances[entrance_label[entrance_sets.find(i)]-1].interior = true;
+    }
+  }
+  auto find_entrance_label = [&](const size_t i) -> CavityID {
+    return (cavity_types && interface_vxl[i])? entrance_label[entrance_sets.find(i)] : 0;
+  };
+
+  // the seam voxels of the previous slab are looked up in this slab. both slabs assign the same
+  // types to the seam voxels, so that each of them is a core voxel in both slabs
+  const unsigned bot_lvl_offset = _slab_offset << _max_depth;
+  _slab_labels.cavity_links.clear();
+  _slab_labels.entrance_links.clear();
+  for (const SeamVoxel& seam_vxl : _slab_labels.lower_seam){
+    if (seam_vxl.index[0] < bot_lvl_offset){continue;}
+    std::array<unsigned,3> index = seam_vxl.index;
+    index[0] -= bot_lvl_offset;
+    const size_t i = find_core_vxl(findLeaf(index));
+    if (i == n_core){continue;}
+    _slab_labels.cavity_links.push_back({seam_vxl.cavity, root_id[cavity_sets.find(i)]});
+    const CavityID entrance = find_entrance_label(i);
+    if (seam_vxl.entrance != 0 && entrance != 0){
+      _slab_labels.entrance_links.push_back({seam_vxl.entrance, entrance});
+    }
+  }
+  std::vector<SeamVoxel>().swap(_slab_labels.lower_seam);
+  for (auto* links : {&_slab_labels.cavity_links, &_slab_labels.entrance_links}){
+    std::sort(links->begin(), links->end());
+    links->erase(std::unique(links->begin(), links->end()), links->end());
+  }
+
+  // the core voxels that are labelled by this slab and the next slab are passed on to the next slab
+  _slab_labels.upper_seam.clear();
+  const unsigned long label_margin = _labelled_top_x[1] - _interior_top_x[1];
+  const std::array<unsigned long,2> upper_seam_range =
+    {_interior_top_x[1] - std::min(label_margin, _interior_top_x[1]), _labelled_top_x[1]};
+  for (size_t i = 0; i < n_core; ++i){
+    if (!isInSlabRange(core_vxls[i], upper_seam_range)){continue;}
+    std::array<unsigned,3> index;
+    for (char dim = 0; dim < 3; ++dim){
+      index[dim] = core_vxls[i].index[dim] << core_vxls[i].lvl;
+    }
+    index[0] += bot_lvl_offset;
+    _slab_labels.upper_seam.push_back({index, root_id[cavity_sets.find(i)], find_entrance_label(i)});
+  }
+}
+
+// returns true if the top level voxel containing a voxel is in a range along x
+bool Space::isInSlabRange(const VoxelLoc& loc, const std::array<unsigned long,2>& range) const {
+  const unsigned long top_x = loc.index[0] >> (_max_depth - loc.lvl);
+  return top_x >= range[0] && top_x < range[1];
+}
+
+// returns the pure voxel that contains a voxel, or the voxel itself if it has been split. the
+// sparse octree returns it in place of the voxel anyway
+const Voxel& Space::findPureVxl(const std::array<unsigned,3>& index, const int lvl) const {
+  if (_sparse){return _sparse_grid.getElement(index, lvl);}
+  for (int anc_lvl = _max_depth; anc_lvl > lvl; --anc_lvl){
+    const int shift = anc_lvl - lvl;
+    const Voxel& anc = _grid[anc_lvl].getElement(index[0] >> shift, index[1] >> shift, index[2] >> shift);
+    if (!anc.hasSubvoxel()){return anc;}
+  }
+  return _grid[lvl].getElement(index);
+}
+
+// calls visit(vxl, loc, block_start, block_end) for every pure voxel that overlaps a range of bottom
+// level voxels, with the part of the range that it covers. the voxels below a pure voxel are not
+// read, so that uniform regions of the grid cost one call per pure voxel instead of one per bottom
+// level voxel
+template<typename Visit>
+void Space::forEachPureVxl(const std::array<unsigned,3>& start_index, const std::array<unsigned,3>& end_index, Visit visit) const {
+  std::array<unsigned,3> top_start;
+  std::array<unsigned,3> top_end;
+  for (char dim = 0; dim < 3; ++dim){
+    if (start_index[dim] >= end_index[dim]){return;}
+    top_start[dim] = start_index[dim] >> _max_depth;
+    top_end[dim] = ((end_index[dim] - 1) >> _max_depth) + 1;
+  }
+  std::array<unsigned,3> top_index;
+  for (top_index[2] = top_start[2]; top_index[2] < top_end[2]; ++top_index[2]){
+    for (top_index[1] = top_start[1]; top_index[1] < top_end[1]; ++top_index[1]){
+      for (top_index[0] = top_start[0]; top_index[0] < top_end[0]; ++top_index[0]){
+        visitPureVxls(top_index, _max_depth, start_index, end_index, visit);
+      }
+    }
+  }
+}
+
+template<typename Visit>
+void Space::visitPureVxls(const std::array<unsigned,3>& index, const int lvl, const std::array<unsigned,3>& start_index, const std::array<unsigned,3>& end_index, Visit& visit) const {
+  std::array<unsigned,3> block_start;
+  std::array<unsigned,3> block_end;
+  for (char dim = 0; dim < 3; ++dim){
+    block_start[dim] = std::max(index[dim] << lvl, start_index[dim]);
+    block_end[dim] = std::min((index[dim] + 1) << lvl, end_index[dim]);
+    if (block_start[dim] >= block_end[dim]){return;}
+  }
+  const Voxel& vxl = getVxlFromGrid(index, lvl);
+  if (!vxl.hasSubvoxel()){
+    visit(vxl, VoxelLoc(index, lvl), block_start, block_end);
+    return;
+  }
+  std::array<unsigned,3> subindex;
+  for (subindex[2] = block_start[2] >> (lvl-1); subindex[2] <= (block_end[2]-1) >> (lvl-1); ++subindex[2]){
+    for (subindex[1] = block_start[1] >> (lvl-1); subindex[1] <= (block_end[1]-1) >> (lvl-1); ++subindex[1]){
+      for (subindex[0] = block_start[0] >> (lvl-1); subindex[0] <= (block_end[0]-1) >> (lvl-1); ++subindex[0]){
+        if (lvl == 1){
+          // bottom level voxels are pure and lie in the range
+          visit(getVxlFromGrid(subindex, 0), VoxelLoc(subindex, 0), subindex, {subindex[0]+1, subindex[1]+1, subindex[2]+1});
+        }
+        else {
+          visitPureVxls(subindex, lvl-1, start_index, end_index, visit);
         }
       }
     }
-    Ctrl::getInstance()->updateProgressBar(int(100*(double(vxl_index[0])+1)/double(getGridsteps()[0])));
   }
 }
 
-// this function finds the lowest level core voxel. this voxel becomes the entry point
-// for the flood fill
-void Space::descendToCore(std::vector<Cavity>& cavities, unsigned char& id, const std::array<unsigned,3> index, int lvl, const bool cavity_types){
+// returns the pure voxel that contains a bottom level voxel
+VoxelLoc Space::findLeaf(const std::array<unsigned,3>& bot_lvl_index){
+  int lvl = _max_depth;
+  std::array<unsigned,3> index;
+  while (true){
+    for (char dim = 0; dim < 3; ++dim){
+      index[dim] = bot_lvl_index[dim] >> lvl;
+    }
+    if (lvl == 0 || !getVxlFromGrid(index, lvl).hasSubvoxel()){break;}
+    --lvl;
+  }
+  return VoxelLoc(index, lvl);
+}
+
+// lists the pure core voxels inside a voxel in the order of a depth first traversal
+void Space::listCoreVoxels(std::vector<VoxelLoc>& core_vxls, const std::array<unsigned,3>& index, const int lvl){
   Voxel& vxl = getVxlFromGrid(index,lvl);
   if (!vxl.isCore()){return;}
   if (!vxl.hasSubvoxel()){
-    if(vxl.floodFill(cavities, id, index, lvl, cavity_types)){
-      if (id == 0b11111111){
-        throw std::overflow_error("Too many isolated cavities detected!");
-      }
-      id++;
-    }
+    core_vxls.push_back(VoxelLoc(index, lvl));
   }
   else {
     std::array<unsigned,3> subindex;
@@ -193,40 +540,142 @@ void Space::descendToCore(std::vector<Cavity>& cavities, unsigned char& id, cons
         subindex[1] = index[1]*2 + j;
         for (char k = 0; k < 2; ++k){
           subindex[2] = index[2]*2 + k;
-          if (Ctrl::getInstance()->getAbortFlag()){return;}
-          try {descendToCore(cavities, id, subindex, lvl-1, cavity_types);}
-          catch (const std::overflow_error& e){throw;}
+          listCoreVoxels(core_vxls, subindex, lvl-1);
         }
       }
     }
   }
 }
 
+// returns the index of the i-th top level voxel in x-y-z order
+std::array<unsigned,3> Space::calcTopIndex(const size_t i){
+  const std::array<unsigned long,3> n_top = getGridsteps();
+  return {static_cast<unsigned>(i / (n_top[1] * n_top[2])),
+          static_cast<unsigned>((i / n_top[2]) % n_top[1]),
+          static_cast<unsigned>(i % n_top[2])};
+}
+
+// returns the position of the top level voxel containing a voxel in x-y-z order
+size_t Space::calcTopPosition(const VoxelLoc& loc){
+  const std::array<unsigned long,3> n_top = getGridsteps();
+  std::array<size_t,3> top;
+  for (char dim = 0; dim < 3; ++dim){
+    top[dim] = loc.index[dim] >> (_max_depth - loc.lvl);
+  }
+  return (top[0] * n_top[1] + top[1]) * n_top[2] + top[2];
+}
+
+// returns the position of a voxel in the depth first traversal of its top level voxel. this is
+// the morton code of the first bottom level voxel it contains, with the x-axis as the most
+// significant axis
+unsigned long long Space::calcScanKey(const VoxelLoc& loc) const {
+  unsigned long long key = 0;
+  for (int bit = _max_depth-1; bit >= loc.lvl; --bit){
+    for (char dim = 0; dim < 3; ++dim){
+      key = (key << 1) | ((loc.index[dim] >> (bit - loc.lvl)) & 1);
+    }
+  }
+  return key << (3 * loc.lvl);
+}
+
+// every voxel reads the types of neighbours within the probe search range, which may belong
+// to other top level voxels, and writes only to itself and its own subvoxels. to avoid
+// reading voxels that are written by another thread, the top level grid is partitioned into
+// tiles that are at least as wide as the search range. the tiles are coloured by the parity
+// of their tile index and all tiles of one colour are processed concurrently. tiles of the
+// same colour are separated by at least one tile of another colour, so that their read and
+// write regions never overlap. the result does not depend on the processing order, because
+// the pass never changes the core bits and IDs that are read from neighbours
+template<bool t_masking_mode>
 void Space::assignShellVsVoid(){
   if (Ctrl::getInstance()->getAbortFlag()){return;}
-  std::array<unsigned int,3> vxl_index;
-  for(vxl_index[0] = 0; vxl_index[0] < getGridsteps()[0]; vxl_index[0]++){
-    Ctrl::getInstance()->updateCalculationStatus();
-    for(vxl_index[1] = 0; vxl_index[1] < getGridsteps()[1]; vxl_index[1]++){
-      for(vxl_index[2] = 0; vxl_index[2] < getGridsteps()[2]; vxl_index[2]++){
-        if (Ctrl::getInstance()->getAbortFlag()){return;}
-        getTopVxl(vxl_index).evalRelationToVoxels(vxl_index, _max_depth);
+  const std::array<unsigned long,3> n_top = getGridsteps();
+  const unsigned long tile_size = calcTileSize();
+  std::array<unsigned long,3> n_tiles;
+  for (char dim = 0; dim < 3; ++dim){
+    n_tiles[dim] = (n_top[dim] + tile_size - 1)/tile_size;
+  }
+
+  // the neighbour search of a voxel must not reach past the edges of a slab. voxels close to the
+  // edges are left unassigned, since they only lie in the halo of the slab. a voxel that was left
+  // unassigned by the large probe is also left unassigned by the small probe
+  std::array<unsigned long,2> eval_top_x = {0, n_top[0]};
+  if (_slab){
+    _slab_search_reach = std::max(_slab_search_reach, calcSearchReach(Voxel::getProbeRadius()));
+    if (_slab_offset > 0){eval_top_x[0] = _slab_search_reach;}
+    if (!_slab_at_grid_end){eval_top_x[1] = n_top[0] - std::min(_slab_search_reach, n_top[0]);}
+  }
+  if (_distance_transform && !_sparse){
+    assignShellVsVoidByDistance<t_masking_mode>(eval_top_x);
+    return;
+  }
+
+  const size_t n_total_tiles = n_tiles[0]*n_tiles[1]*n_tiles[2];
+  ThreadPool::progress_type report_progress = makeProgressReporter(n_total_tiles);
+  size_t n_tiles_done = 0;
+
+  for (char colour = 0; colour < 8; ++colour){
+    if (Ctrl::getInstance()->getAbortFlag()){return;}
+    // list all tiles of the current colour
+    std::vector<std::array<unsigned long,3>> tiles;
+    std::array<unsigned long,3> tile;
+    for (tile[0] = colour%2; tile[0] < n_tiles[0]; tile[0] += 2){
+      for (tile[1] = (colour/2)%2; tile[1] < n_tiles[1]; tile[1] += 2){
+        for (tile[2] = (colour/4)%2; tile[2] < n_tiles[2]; tile[2] += 2){
+          tiles.push_back(tile);
+        }
       }
     }
-    Ctrl::getInstance()->updateProgressBar(int(100*(double(vxl_index[0])+1)/double(getGridsteps()[0])));
+
+    ThreadPool(_n_threads).parallelFor(tiles.size(),
+      [&](const size_t i, const unsigned){
+        std::array<unsigned,3> start;
+        std::array<unsigned,3> end;
+        for (char dim = 0; dim < 3; ++dim){
+          start[dim] = tiles[i][dim] * tile_size;
+          end[dim] = std::min(start[dim] + tile_size, n_top[dim]);
+        }
+        start[0] = std::max<unsigned long>(start[0], eval_top_x[0]);
+        end[0] = std::min<unsigned long>(end[0], eval_top_x[1]);
+        std::array<unsigned,3> vxl_index;
+        for (vxl_index[0] = start[0]; vxl_index[0] < end[0]; vxl_index[0]++){
+          for (vxl_index[1] = start[1]; vxl_index[1] < end[1]; vxl_index[1]++){
+            for (vxl_index[2] = start[2]; vxl_index[2] < end[2]; vxl_index[2]++){
+              if (Ctrl::getInstance()->getAbortFlag()){return;}
+              getTopVxl(vxl_index).evalRelationToVoxels<t_masking_mode>(vxl_index, _max_depth);
+            }
+          }
+        }
+      },
+      [&](const size_t n_done){report_progress(n_tiles_done + n_done);});
+    n_tiles_done += tiles.size();
   }
 }
 
+// returns the minimum side length of a tile, in units of top level voxels, so that the
+// neighbour search of all voxels inside a tile only reaches into directly adjacent tiles.
+// tiles consist of whole palette blocks, so that a palette is only modified by one thread
+unsigned long Space::calcTileSize() const {
+  unsigned long tile_size = 1;
+  for (int lvl = 0; lvl <= _max_depth; ++lvl){
+    const unsigned long vxl_per_top = pow2(_max_depth-lvl);
+    const unsigned long range = Voxel::getSearchRange(lvl);
+    tile_size = std::max(tile_size, (range + vxl_per_top - 1)/vxl_per_top);
+  }
+  const unsigned long top_per_block = 1ul << (_palette_lvl - _max_depth);
+  return ((tile_size + top_per_block - 1)/top_per_block) * top_per_block;
+}
+
 void Space::sumVolume(std::map<char,double>& volumes, std::vector<Cavity>& cavities, const bool unit_cell){
   // clear all output variables
   volumes.clear();
   // create maps used for tallying voxels
   std::map<char, double> type_tally;
-  std::map<unsigned char, double> id_core_tally;
-  std::map<unsigned char, double> id_shell_tally;
+  std::map<CavityID, double> id_core_tally;
+  std::map<CavityID, double> id_shell_tally;
   // contain the boundaries in which all voxels of a given ID are contained
-  std::map<unsigned char, std::array<unsigned,3>> id_min;
-  std::map<unsigned char, std::array<unsigned,3>> id_max;
+  std::map<CavityID, std::array<unsigned,3>> id_min;
+  std::map<CavityID, std::array<unsigned,3>> id_max;
 
   if(unit_cell){
     setUnitCellIndexes();
@@ -235,6 +684,11 @@ void Space::sumVolume(std::map<char,double>& volumes, std::vector<Cavity>& cavit
   int tally_lvl = unit_cell? 0 : _max_depth;
   std::array<unsigned,3> start_index = unit_cell? _unit_cell_start_index : std::array<unsigned,3>();
   std::array<unsigned,3> end_index = unit_cell? _unit_cell_end_index : getGridstepsOnLvl<unsigned>(tally_lvl);
+  // a slab only tallies the voxels in its interior
+  if (!unit_cell){
+    start_index[0] = _interior_top_x[0];
+    end_index[0] = _interior_top_x[1];
+  }
 
   // count bottom level voxels per type
   std::array<unsigned int,3> vxl_index;
@@ -289,10 +743,11 @@ void Space::sumVolume(std::map<char,double>& volumes, std::vector<Cavity>& cavit
   // convert from units of bottom level voxels to units of volume
   // convert from index to spatial coordinates
   // copy values from map to vector for more efficient storage and access
-  // ignore id == 0; this is not a cavity but all voxels that are neither core nor shell
-  for (auto& [id,tally] : id_core_tally) {
-    if (id == 0){continue;}
-    cavities[id-1].core_vol = tally * unit_volume;
+  // ignore id == 0; this is not a cavity but all voxels that are neither core nor shell.
+  // only a slab keeps cavities without core voxels, whose core lies outside of the interior
+  for (auto& [id,min_index] : id_min) {
+    if (id == 0 || (!_slab && id_core_tally.count(id) == 0)){continue;}
+    cavities[id-1].core_vol = id_core_tally[id] * unit_volume;
     cavities[id-1].shell_vol = id_shell_tally[id] * unit_volume;
     cavities[id-1].id = id;
     for (char i = 0; i < 3; ++i){
@@ -302,7 +757,9 @@ void Space::sumVolume(std::map<char,double>& volumes, std::vector<Cavity>& cavit
       cavities[id-1].max_index[i] = id_max[id][i];
     }
   }
-  // remove cavities with volume equal to zero (artefacts from unit cell mode)
+  // remove cavities with volume equal to zero (artefacts from unit cell mode). a slab keeps them,
+  // because a cavity may have voxels in the interior of another slab
+  if (_slab){return;}
   for (auto it = cavities.begin(); it != cavities.end(); it++)
   {
     if ((*it).getVolume() == 0){
@@ -326,59 +783,122 @@ void Space::setUnitCellIndexes(){
 // SURFACE AREA //
 //////////////////
 
-// overloaded for full molecule surfaces
-// sets the appropriate start and end indices
-double Space::calcSurfArea(const std::vector<char>& types){
+// calculates the surfaces of all sets of solid types in a single pass through the grid. the
+// surfaces of the cavities with the IDs 1 to max_id are calculated for the cavity sets
+SurfaceAreas Space::calcSurfAreas(const std::vector<std::vector<char>>& solid_types, const std::vector<size_t>& cavity_sets, const CavityID max_id){
   std::array<unsigned,3> start_index = _unit_cell? _unit_cell_start_index : std::array<unsigned,3>({0,0,0});
-  std::array<unsigned,3> end_index   = _unit_cell? _unit_cell_end_index   : getGrid(0).getNumElements<unsigned>();
-  double surface = tallySurface(types, start_index, end_index);
-  // scale the surface area in squared gridstep units
-  return (surface * (_grid_size*_grid_size));
+  std::array<unsigned,3> end_index   = _unit_cell? _unit_cell_end_index   : getGridstepsOnLvl<unsigned>(0);
+  clampToInterior(start_index, end_index);
+  SurfaceAreas areas = tallySurfaces(makeSolidSets(solid_types, cavity_sets, max_id), start_index, end_index);
+  // scale the surface areas in squared gridstep units
+  for (double& surface : areas.total){
+    surface *= _grid_size*_grid_size;
+  }
+  for (std::vector<double>& cavity_surfaces : areas.cavities){
+    for (double& surface : cavity_surfaces){
+      surface *= _grid_size*_grid_size;
+    }
+  }
+  return areas;
+}
+
+// restricts a range of bottom level voxels to the marching cubes whose first voxel lies in the
+// interior of a slab. the last cube reads one voxel past the interior
+void Space::clampToInterior(std::array<unsigned,3>& start_index, std::array<unsigned,3>& end_index) const {
+  const unsigned interior_start = _interior_top_x[0] << _max_depth;
+  const unsigned interior_end = _interior_top_x[1] << _max_depth;
+  start_index[0] = std::max(start_index[0], interior_start);
+  end_index[0] = std::min({end_index[0], interior_end + 1, getGridstepsOnLvl<unsigned>(0)[0]});
 }
 
-// overload for cavity surfaces
-// solid types MUST also have appropriate ID!
-double Space::calcSurfArea(const std::vector<char>& types, const unsigned char id, std::array<unsigned int,3> start_index, std::array<unsigned int,3> end_index){
-  if(Ctrl::getInstance()->getAbortFlag()){return 0;}
-  // the surface area is counted between voxels, thus we need to check voxels around the limits of the cavity
-  if(!_unit_cell){
-    for(char i = 0; i < 3; i++){
-      std::array<unsigned long,3> n_elements = getGrid(0).getNumElements();
-      if(start_index[i] > 0){start_index[i]--;}
-      // increase end_index twice because it should be above the range of indexes checked like vector and array sizes in C++
-      if(end_index[i] < n_elements[i]){end_index[i]++;}
-      if(end_index[i] < n_elements[i]){end_index[i]++;}
+// at most eight sets of solid types are supported
+Space::SolidSets Space::makeSolidSets(const std::vector<std::vector<char>>& solid_types, const std::vector<size_t>& cavity_sets, const CavityID max_id){
+  SolidSets sets = {{}, solid_types.size(), cavity_sets, 0, max_id};
+  for (size_t set = 0; set < solid_types.size(); ++set){
+    for (const char type : solid_types[set]){
+      sets.mask_by_type[static_cast<unsigned char>(type)] |= 1 << set;
     }
   }
-  // for unit cell analysis, surfaces outside the unit cell should not be included
-  else{
-    for(char i = 0; i < 3; i++){
-      if(start_index[i] > _unit_cell_start_index[i]){start_index[i]--;}
-      // increase end_index twice because it should be above the range of indexes checked like vector and array sizes in C++
-      if(end_index[i] < _unit_cell_end_index[i]){end_index[i]++;}
-      if(end_index[i] < _unit_cell_end_index[i]){end_index[i]++;}
+  for (const size_t set : cavity_sets){
+    sets.cavity_mask |= 1 << set;
+  }
+  return sets;
+}
+
+// the configuration of a marching cube for the voxels of one set, given the sets of its corners
+unsigned char selectSetConfig(const std::array<unsigned char,8>& corner_sets, const size_t set){
+  unsigned char config = 0;
+  for (unsigned corner = 0; corner < 8; ++corner){
+    config |= ((corner_sets[corner] >> set) & 1) << corner;
+  }
+  return config;
+}
+
+// calls add(j, id, config) with the configuration of a marching cube for the voxels of the j-th
+// cavity set that belong to the cavity id, for every cavity up to max_id that has a voxel among the
+// corners. cavities that were removed after the type assignment may have larger IDs
+template<typename AddFunc>
+void forEachCavityConfig(const std::array<unsigned char,8>& corner_sets, const std::array<CavityID,8>& ids, const std::vector<size_t>& cavity_sets, const CavityID max_id, AddFunc add){
+  for (unsigned first = 0; first < 8; ++first){
+    const CavityID id = ids[first];
+    // every cavity is handled at the first corner that belongs to it
+    if (id == 0 || id > max_id || std::find(ids.begin(), ids.begin() + first, id) != ids.begin() + first){continue;}
+    for (size_t j = 0; j < cavity_sets.size(); ++j){
+      unsigned char config = 0;
+      for (unsigned corner = first; corner < 8; ++corner){
+        if (ids[corner] == id){
+          config |= ((corner_sets[corner] >> cavity_sets[j]) & 1) << corner;
+        }
+      }
+      add(j, id, config);
     }
   }
-  double surface = tallySurface(types, start_index, end_index, id, true);
-  // scale the surface area in squared gridstep units
-  return (surface * (_grid_size*_grid_size));
 }
 
-double Space::tallySurface(const std::vector<char>& types, std::array<unsigned int,3>& start_index, std::array<unsigned int,3>& end_index, const unsigned char id, const bool cavity){
-  double surface = 0;
+// the grid is read once for all sets of solid types, a plane along z at a time, by walking the
+// octree. the marching cubes in the range are counted by their type and the counts are converted
+// to an area at the end. the cavity IDs of the voxels of the cavity sets are kept for two planes.
+// the partial cubes at the borders of the unit cell are weighted and summed directly
+SurfaceAreas Space::tallySurfaces(const SolidSets& sets, const std::array<unsigned,3>& start_index, const std::array<unsigned,3>& end_index){
+  SurfaceAreas areas = {std::vector<double>(sets.n_sets, 0),
+    std::vector<std::vector<double>>(sets.cavity_sets.size(), std::vector<double>(sets.max_id+1, 0))};
 
-  // loop over all voxels within range minus one in each direction because the +1 neighbors will be checked at the same time
-  std::array<unsigned int,3> index;
   Ctrl::getInstance()->updateCalculationStatus();
-  for(index[2] = start_index[2]; index[2] < end_index[2]-1; index[2]++){
-    for(index[1] = start_index[1]; index[1] < end_index[1]-1; index[1]++){
-      if(Ctrl::getInstance()->getAbortFlag()){return 0;}
-      for(index[0] = start_index[0]; index[0] < end_index[0]-1; index[0]++){
-        surface += SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity));
+  std::vector<BitPlane> solid(sets.n_sets, BitPlane(start_index, end_index));
+  std::vector<SurfaceLUT::TypeCounts> counts(sets.n_sets, SurfaceLUT::TypeCounts());
+  std::vector<std::vector<SurfaceLUT::TypeCounts>> cavity_counts
+    (sets.cavity_sets.size(), std::vector<SurfaceLUT::TypeCounts>(sets.max_id+1, SurfaceLUT::TypeCounts()));
+  std::array<CavityLayer,2> layers;
+  readSurfacePlane(sets, start_index[2], CavityLayer(), solid, layers[1]);
+
+  // loop over all voxels within range minus one in each direction because the +1 neighbors will be checked at the same time
+  const ThreadPool::progress_type report_progress = makeProgressReporter(end_index[2] - start_index[2]);
+  for(unsigned z = start_index[2]; z < end_index[2]-1; z++){
+    std::swap(layers[0], layers[1]);
+    readSurfacePlane(sets, z+1, layers[0], solid, layers[1]);
+    for(unsigned y = start_index[1]; y < end_index[1]-1; y++){
+      if(Ctrl::getInstance()->getAbortFlag()){return areas;}
+      for (size_t set = 0; set < sets.n_sets; ++set){
+        tallyRowSurface(solid[set], y, z, counts[set]);
+      }
+      if (!sets.cavity_sets.empty()){
+        tallyRowCavitySurfaces(sets, solid, layers, y, z, cavity_counts);
       }
     }
+    report_progress(z - start_index[2] + 1);
   }
+  for (size_t set = 0; set < sets.n_sets; ++set){
+    areas.total[set] = SurfaceLUT::countsToArea(counts[set]);
+  }
+  for (size_t j = 0; j < sets.cavity_sets.size(); ++j){
+    for (CavityID id = 1; id <= sets.max_id; ++id){
+      areas.cavities[j][id] = SurfaceLUT::countsToArea(cavity_counts[j][id]);
+    }
+  }
+
   if(_unit_cell){
+    std::array<unsigned,3> index;
+    auto addCube = [&](const double weight){addCubeSurfaces(index, weight, sets, areas);};
     /* the surface area is counted between voxels, thus the borders of the unit cell should include partial surface area by configuration
     since the surface area is not homogeneous over the voxel, the surface area from the borders will be an approximation
     -1,-1,-1 *1/8 on 1 vertex
@@ -396,19 +916,18 @@ double Space::tallySurface(const std::vector<char>& types, std::array<unsigned i
     for(int i = 0; i < 3; i++){
       index[i] = _unit_cell_start_index[i]-1;
     }
-    surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) * 0.125);
+    addCube(0.125);
 
     // add last n,n,n vertex
     for(int i = 0; i < 3; i++){
       index[i] = _unit_cell_end_index[i]-1;
     }
-    surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) *
-                (0.125 +
-                 ((_unit_cell_mod_index[0] + _unit_cell_mod_index[1] + _unit_cell_mod_index[2])/4) +
-                 (_unit_cell_mod_index[0] * _unit_cell_mod_index[1]/2) +
-                 (_unit_cell_mod_index[0] * _unit_cell_mod_index[2]/2) +
-                 (_unit_cell_mod_index[1] * _unit_cell_mod_index[2]/2) +
-                 (_unit_cell_mod_index[0] * _unit_cell_mod_index[1] * _unit_cell_mod_index[2])));
+    addCube(0.125 +
+            ((_unit_cell_mod_index[0] + _unit_cell_mod_index[1] + _unit_cell_mod_index[2])/4) +
+            (_unit_cell_mod_index[0] * _unit_cell_mod_index[1]/2) +
+            (_unit_cell_mod_index[0] * _unit_cell_mod_index[2]/2) +
+            (_unit_cell_mod_index[1] * _unit_cell_mod_index[2]/2) +
+            (_unit_cell_mod_index[0] * _unit_cell_mod_index[1] * _unit_cell_mod_index[2]));
 
     // swap x,y,z
     for(int n = 0; n < 3; n++){
@@ -420,39 +939,37 @@ double Space::tallySurface(const std::vector<char>& types, std::array<unsigned i
       index[i] = _unit_cell_start_index[i]-1;
       index[j] = _unit_cell_start_index[j]-1;
       index[k] = _unit_cell_end_index[k]-1;
-      surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) * (0.125 + (_unit_cell_mod_index[k]/4)));
+      addCube(0.125 + (_unit_cell_mod_index[k]/4));
 
       // add the last three intermediate vertices -1,n,n
       index[i] = _unit_cell_start_index[i]-1;
       index[j] = _unit_cell_end_index[j]-1;
       index[k] = _unit_cell_end_index[k]-1;
-      surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) *
-                  (0.125 +
-                   ((_unit_cell_mod_index[j] + _unit_cell_mod_index[k])/4) +
-                   (_unit_cell_mod_index[j] * _unit_cell_mod_index[k]/2)));
+      addCube(0.125 +
+              ((_unit_cell_mod_index[j] + _unit_cell_mod_index[k])/4) +
+              (_unit_cell_mod_index[j] * _unit_cell_mod_index[k]/2));
 
       // add the three start edges -1,-1,k
       index[i] = _unit_cell_start_index[i]-1;
       index[j] = _unit_cell_start_index[j]-1;
       for (index[k] = _unit_cell_start_index[k]; index[k] < _unit_cell_end_index[k]-1; index[k]++){
-        surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) * 0.25);
+        addCube(0.25);
       }
 
       // add the three end edges n,n,k
       index[i] = _unit_cell_end_index[i]-1;
       index[j] = _unit_cell_end_index[j]-1;
       for (index[k] = _unit_cell_start_index[k]; index[k] < _unit_cell_end_index[k]-1; index[k]++){
-        surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) *
-                    (0.25 +
-                     ((_unit_cell_mod_index[j] + _unit_cell_mod_index[k])/2) +
-                     (_unit_cell_mod_index[j] * _unit_cell_mod_index[k])));
+        addCube(0.25 +
+                ((_unit_cell_mod_index[j] + _unit_cell_mod_index[k])/2) +
+                (_unit_cell_mod_index[j] * _unit_cell_mod_index[k]));
       }
 
       // add the three start faces -1,j,k
       index[i] = _unit_cell_start_index[i]-1;
       for (index[j] = _unit_cell_start_index[j]; index[j] < _unit_cell_end_index[j]-1; index[j]++){
         for (index[k] = _unit_cell_start_index[k]; index[k] < _unit_cell_end_index[k]-1; index[k]++){
-          surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) * 0.5);
+          addCube(0.5);
         }
       }
 
@@ -460,7 +977,7 @@ double Space::tallySurface(const std::vector<char>& types, std::array<unsigned i
       index[i] = _unit_cell_end_index[i]-1;
       for (index[j] = _unit_cell_start_index[j]; index[j] < _unit_cell_end_index[j]-1; index[j]++){
         for (index[k] = _unit_cell_start_index[k]; index[k] < _unit_cell_end_index[k]-1; index[k]++){
-          surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) * (0.5 + _unit_cell_mod_index[i]));
+          addCube(0.5 + _unit_cell_mod_index[i]);
         }
       }
 
@@ -468,23 +985,243 @@ double Space::tallySurface(const std::vector<char>& types, std::array<unsigned i
       index[i] = _unit_cell_start_index[i]-1;
       index[j] = _unit_cell_end_index[j]-1;
       for (index[k] = _unit_cell_start_index[k]; index[k] < _unit_cell_end_index[k]-1; index[k]++){
-        surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) * (0.25 + (_unit_cell_mod_index[j]/2)));
+        addCube(0.25 + (_unit_cell_mod_index[j]/2));
       }
       index[i] = _unit_cell_end_index[i]-1;
       index[j] = _unit_cell_start_index[j]-1;
       for (index[k] = _unit_cell_start_index[k]; index[k] < _unit_cell_end_index[k]-1; index[k]++){
-        surface += (SurfaceLUT::configToArea(evalMarchingCubeConfig(index, types, id, cavity)) * (0.25 + (_unit_cell_mod_index[i]/2)));
+        addCube(0.25 + (_unit_cell_mod_index[i]/2));
       }
     }
   }
-  return surface;
+  return areas;
 }
 
-bool isSolid(const Voxel&, const std::vector<char>&);
+// the corners of the 64 marching cubes whose lowest corners are the voxels of the i-th word of the
+// row at y,z, in the same order as the bits of the configuration
+std::array<BitPlane::word_type,8> readCubeCorners(const BitPlane& solid, const size_t i, const unsigned y, const unsigned z){
+  typedef BitPlane::word_type word_type;
+  std::array<word_type,8> corners;
+  for (unsigned dy = 0; dy < 2; ++dy){
+    for (unsigned dz = 0; dz < 2; ++dz){
+      const word_type word = solid.getWord(i, y+dy, z+dz);
+      const word_type next_word = solid.getWord(i+1, y+dy, z+dz);
+      corners[dz + 2*dy] = word;
+      corners[dz + 2*dy + 4] = (word >> 1) | (next_word << (BitPlane::word_bits-1));
+    }
+  }
+  return corners;
+}
+
+// counts the marching cubes in the row at y,z, whose lowest corner lies in the range of the plane
+// minus one voxel in each direction, by their type. the corners of 64 cubes are evaluated at once.
+// cubes whose corners are either all solid or all empty contain no surface and are skipped
+void Space::tallyRowSurface(const BitPlane& solid, const unsigned y, const unsigned z, SurfaceLUT::TypeCounts& counts) const {
+  typedef BitPlane::word_type word_type;
+  const unsigned n_cubes = solid.getEnd()[0] - solid.getStart()[0] - 1;
+  for (size_t i = 0; i * BitPlane::word_bits < n_cubes; ++i){
+    const std::array<word_type,8> corners = readCubeCorners(solid, i, y, z);
+    word_type all_solid = ~word_type(0);
+    word_type any_solid = 0;
+    for (const word_type corner : corners){
+      all_solid &= corner;
+      any_solid |= corner;
+    }
+    word_type mixed = any_solid & ~all_solid;
+    // exclude cubes past the end of the row
+    const size_t n_cubes_in_word = std::min<size_t>(BitPlane::word_bits, n_cubes - i * BitPlane::word_bits);
+    if (n_cubes_in_word < BitPlane::word_bits){
+      mixed &= (word_type(1) << n_cubes_in_word) - 1;
+    }
+    while (mixed){
+      const int bit = std::countr_zero(mixed);
+      unsigned char config = 0;
+      for (unsigned corner = 0; corner < 8; ++corner){
+        config |= ((corners[corner] >> bit) & 1) << corner;
+      }
+      ++counts[SurfaceLUT::configToType(config)];
+      mixed &= mixed - 1;
+    }
+  }
+}
+
+// reads the plane at z from the octree. the voxels of every set of solid types are flagged in the
+// solid planes, so that the marching cubes only need to read one bit per corner and set. for the
+// cavity sets, the cavity IDs of their voxels are stored in the layer, the other voxels keep the ID
+// 0. the octree is walked down to the pure voxels, whose type and ID are applied to all of their
+// bottom level voxels in the plane at once, a row at a time
+void Space::readSurfacePlane(const SolidSets& sets, const unsigned z, const CavityLayer& below, std::vector<BitPlane>& solid, CavityLayer& layer) const {
+  const std::array<unsigned,3>& start_index = solid[0].getStart();
+  const std::array<unsigned,3>& end_index = solid[0].getEnd();
+  const size_t n_x = end_index[0] - start_index[0];
+  const bool cavities = !sets.cavity_sets.empty();
+  if (cavities){layer.ids.assign(n_x * (end_index[1] - start_index[1]), 0);}
+  forEachPureVxl({start_index[0], start_index[1], z}, {end_index[0], end_index[1], z+1},
+      [&](const Voxel& vxl, const VoxelLoc& loc, const std::array<unsigned,3>& block_start, const std::array<unsigned,3>& block_end){
+    const unsigned char vxl_sets = sets.mask_by_type[static_cast<unsigned char>(vxl.getType())];
+    if (!vxl_sets){return;}
+    const CavityID id = (cavities && (vxl_sets & sets.cavity_mask))? lookUpCavityID(vxl.getLocalID(), loc.index, loc.lvl) : 0;
+    std::array<unsigned,3> index = block_start;
+    for (index[1] = block_start[1]; index[1] < block_end[1]; index[1]++){
+      for (size_t set = 0; set < sets.n_sets; ++set){
+        if ((vxl_sets >> set) & 1){solid[set].setBits(index, block_end[0] - block_start[0]);}
+      }
+      if (id != 0){
+        const auto row = layer.ids.begin() + n_x * (index[1] - start_index[1]);
+        std::fill(row + (block_start[0] - start_index[0]), row + (block_end[0] - start_index[0]), id);
+      }
+    }
+  });
+  if (cavities){flagCavitySteps(sets, solid, z, below, layer);}
+}
+
+// a voxel is flagged as a step along x or y, if its ID differs from that of the next voxel along
+// the axis, and as a step along z, if it differs from that of the voxel below
+void Space::flagCavitySteps(const SolidSets& sets, const std::vector<BitPlane>& solid, const unsigned z, const CavityLayer& below, CavityLayer& layer) const {
+  typedef BitPlane::word_type word_type;
+  const std::array<unsigned,3>& start_index = solid[0].getStart();
+  const std::array<unsigned,3>& end_index = solid[0].getEnd();
+  const size_t n_x = end_index[0] - start_index[0];
+  const size_t n_y = end_index[1] - start_index[1];
+  const size_t n_words = solid[0].getNumWordsPerRow();
+  auto getCavityWord = [&](const size_t i, const unsigned row_y, const unsigned row_z){
+    word_type word = 0;
+    for (const size_t set : sets.cavity_sets){
+      word |= solid[set].getWord(i, row_y, row_z);
+    }
+    return word;
+  };
+
+  const bool has_below = !below.ids.empty();
+  for (std::vector<word_type>& steps : layer.steps){
+    steps.assign(n_words * n_y, 0);
+  }
+  for (size_t y = 0; y < n_y; ++y){
+    for (size_t i = 0; i < n_words; ++i){
+      // the voxels of a word are compared with their neighbours only if one of them belongs to a cavity set
+      word_type neighbours = getCavityWord(i, start_index[1] + y, z) | (getCavityWord(i+1, start_index[1] + y, z) & 1);
+      if (y+1 < n_y){neighbours |= getCavityWord(i, start_index[1] + y+1, z);}
+      if (has_below){neighbours |= getCavityWord(i, start_index[1] + y, z-1);}
+      if (!neighbours){continue;}
+      std::array<word_type,3> steps = {0, 0, 0};
+      for (size_t x = i * BitPlane::word_bits; x < std::min(n_x, (i+1) * BitPlane::word_bits); ++x){
+        const size_t pos = x + n_x * y;
+        const unsigned bit = x % BitPlane::word_bits;
+        steps[0] |= word_type(x+1 < n_x && layer.ids[pos] != layer.ids[pos+1]) << bit;
+        steps[1] |= word_type(y+1 < n_y && layer.ids[pos] != layer.ids[pos+n_x]) << bit;
+        steps[2] |= word_type(has_below && layer.ids[pos] != below.ids[pos]) << bit;
+      }
+      for (char dim = 0; dim < 3; ++dim){
+        layer.steps[dim][i + n_words * y] = steps[dim];
+      }
+    }
+  }
+}
+
+// counts the marching cubes of every cavity in the row at y,z by their type. a cube is evaluated,
+// if it contains the surface of one of the cavity sets, or if all of its corners belong to the
+// cavity sets and two of them to different cavities. the latter is the case, if there is a step
+// along one of its edges. as for the total surfaces, 64 cubes are processed at once
+void Space::tallyRowCavitySurfaces(const SolidSets& sets, const std::vector<BitPlane>& solid, const std::array<CavityLayer,2>& layers, const unsigned y, const unsigned z, std::vector<std::vector<SurfaceLUT::TypeCounts>>& cavity_counts) const {
+  typedef BitPlane::word_type word_type;
+  const std::array<unsigned,3>& start_index = solid[0].getStart();
+  const size_t n_x = solid[0].getEnd()[0] - start_index[0];
+  const size_t n_words = solid[0].getNumWordsPerRow();
+  const size_t n_cubes = n_x - 1;
+  std::vector<std::array<word_type,8>> corners(sets.cavity_sets.size());
+  for (size_t i = 0; i * BitPlane::word_bits < n_cubes; ++i){
+    word_type mixed = 0;
+    std::array<word_type,8> cavity_corners = {};
+    for (size_t j = 0; j < sets.cavity_sets.size(); ++j){
+      corners[j] = readCubeCorners(solid[sets.cavity_sets[j]], i, y, z);
+      word_type all_solid = ~word_type(0);
+      word_type any_solid = 0;
+      for (unsigned corner = 0; corner < 8; ++corner){
+        all_solid &= corners[j][corner];
+        any_solid |= corners[j][corner];
+        cavity_corners[corner] |= corners[j][corner];
+      }
+      mixed |= any_solid & ~all_solid;
+    }
+    word_type all_cavity = ~word_type(0);
+    for (const word_type corner : cavity_corners){
+      all_cavity &= corner;
+    }
+
+    // steps of the voxels at x and of the next voxels along x, i.e., of the corners at x+1
+    auto getSteps = [&](const unsigned dz, const char dim, const unsigned dy){
+      const std::vector<word_type>& steps = layers[dz].steps[dim];
+      const size_t row = n_words * (y + dy - start_index[1]);
+      const word_type word = steps[row + i];
+      const word_type next_word = i+1 < n_words? steps[row + i+1] : 0;
+      return std::make_pair(word, (word >> 1) | (next_word << (BitPlane::word_bits-1)));
+    };
+    // the twelve edges of the cubes: four along x, starting at the corners at x, and four along y
+    // and along z, starting at the corners at y and the corners at z+1 respectively
+    word_type id_steps = 0;
+    if (all_cavity){
+      for (unsigned d = 0; d < 2; ++d){
+        for (unsigned e = 0; e < 2; ++e){
+          id_steps |= getSteps(e, 0, d).first;
+        }
+        const auto [y_steps, y_steps_next] = getSteps(d, 1, 0);
+        const auto [z_steps, z_steps_next] = getSteps(1, 2, d);
+        id_steps |= y_steps | y_steps_next | z_steps | z_steps_next;
+      }
+    }
+
+    word_type candidates = mixed | (all_cavity & id_steps);
+    // exclude cubes past the end of the row
+    const size_t n_cubes_in_word = std::min<size_t>(BitPlane::word_bits, n_cubes - i * BitPlane::word_bits);
+    if (n_cubes_in_word < BitPlane::word_bits){
+      candidates &= (word_type(1) << n_cubes_in_word) - 1;
+    }
+    while (candidates){
+      const int bit = std::countr_zero(candidates);
+      const size_t x = i * BitPlane::word_bits + bit;
+      // corners in the same order as the bits of the configuration
+      std::array<CavityID,8> ids;
+      CavityID cube_id = 0;
+      bool single_cavity = true;
+      for (unsigned corner = 0; corner < 8; ++corner){
+        const unsigned dz = corner & 1, dy = (corner >> 1) & 1, dx = corner >> 2;
+        ids[corner] = layers[dz].ids[(x + dx) + n_x * (y + dy - start_index[1])];
+        if (ids[corner] == 0){continue;}
+        if (cube_id == 0){cube_id = ids[corner];}
+        single_cavity &= ids[corner] == cube_id;
+      }
+      // usually, the corners belong to a single cavity, whose configurations are those of the sets
+      if (single_cavity && cube_id != 0 && cube_id <= sets.max_id){
+        for (size_t j = 0; j < sets.cavity_sets.size(); ++j){
+          unsigned char config = 0;
+          for (unsigned corner = 0; corner < 8; ++corner){
+            config |= ((corners[j][corner] >> bit) & 1) << corner;
+          }
+          ++cavity_counts[j][cube_id][SurfaceLUT::configToType(config)];
+        }
+      }
+      else if (!single_cavity){
+        std::array<unsigned char,8> corner_sets = {};
+        for (unsigned corner = 0; corner < 8; ++corner){
+          for (size_t j = 0; j < sets.cavity_sets.size(); ++j){
+            corner_sets[corner] |= ((corners[j][corner] >> bit) & 1) << sets.cavity_sets[j];
+          }
+        }
+        forEachCavityConfig(corner_sets, ids, sets.cavity_sets, sets.max_id,
+            [&cavity_counts](const size_t j, const CavityID id, const unsigned char config){
+              ++cavity_counts[j][id][SurfaceLUT::configToType(config)];
+            });
+      }
+      candidates &= candidates - 1;
+    }
+  }
+}
 
-unsigned char Space::evalMarchingCubeConfig(const std::array<unsigned int,3>& index, const std::vector<char>& types, const unsigned char id, const bool cavity){
-  unsigned char config = 0; // configuration of the marching cube stored as a byte
-  // check the starting voxel and its 7 neighbors to define a marching cube configuration
+// adds the surfaces of a single marching cube, multiplied by a weight, to the surfaces of all sets
+// and cavities
+void Space::addCubeSurfaces(const std::array<unsigned,3>& index, const double weight, const SolidSets& sets, SurfaceAreas& areas) const {
+  std::array<unsigned char,8> corner_sets;
+  std::array<CavityID,8> ids;
   std::array<unsigned,3> subindex;
   for(unsigned int x = 0; x < 2; x++){
     subindex[0] = index[0] + x;
@@ -492,20 +1229,20 @@ unsigned char Space::evalMarchingCubeConfig(const std::array<unsigned int,3>& in
       subindex[1] = index[1] + y;
       for(unsigned int z = 0; z < 2; z++){
         subindex[2] = index[2] + z;
-        // condition for a bit to be true in the byte
-        bool bit_state = isSolid(getVxlFromGrid(subindex, 0), types);
-        if (cavity) {bit_state &= getVxlFromGrid(subindex, 0).getID() == id;}
-        setBit(config, z + 2*y + 4*x, bit_state);
+        const unsigned corner = z + 2*y + 4*x;
+        corner_sets[corner] = sets.mask_by_type[static_cast<unsigned char>(getVxlFromGrid(subindex, 0).getType())];
+        ids[corner] = (corner_sets[corner] & sets.cavity_mask)? getCavityID(subindex, 0) : 0;
       }
     }
   }
-  return config;
-}
-
-inline bool isSolid(const Voxel& vxl, const std::vector<char>& solid_types){
-  return std::find(solid_types.begin(), solid_types.end(), vxl.getType()) != solid_types.end();
+  for (size_t set = 0; set < sets.n_sets; ++set){
+    areas.total[set] += SurfaceLUT::configToArea(selectSetConfig(corner_sets, set)) * weight;
+  }
+  forEachCavityConfig(corner_sets, ids, sets.cavity_sets, sets.max_id,
+      [&areas, weight](const size_t j, const CavityID id, const unsigned char config){
+        areas.cavities[j][id] += SurfaceLUT::configToArea(config) * weight;
+      });
 }
-
 //////////////////////
 // ACCESS FUNCTIONS //
 //////////////////////
@@ -534,27 +1271,93 @@ double Space::getVxlSize() const {
   return _grid_size;
 }
 
+// returns the grid of a level in row-major order. in the sparse mode, or if the grids use a
+// different layout, the requested level is copied into a row-major grid when it is first
+// accessed, e.g., for rendering the surface
 const Container3D<Voxel>& Space::getGrid(const unsigned lvl) const{
-  return _grid[lvl];
+#ifndef MOLOVOL_MORTON_LAYOUT
+  if (!_sparse){return _grid[lvl];}
+#endif
+  if (_expanded_lvl != int(lvl)){
+    const std::array<unsigned,3> n_elements = getGridstepsOnLvl<unsigned>(lvl);
+    _expanded_grid = Container3D<Voxel>(n_elements);
+    std::array<unsigned,3> index;
+    for (index[0] = 0; index[0] < n_elements[0]; ++index[0]){
+      for (index[1] = 0; index[1] < n_elements[1]; ++index[1]){
+        for (index[2] = 0; index[2] < n_elements[2]; ++index[2]){
+          _expanded_grid.getElement(index) = _sparse? _sparse_grid.getElement(index, lvl) : _grid[lvl].getElement(index);
+        }
+      }
+    }
+    _expanded_lvl = lvl;
+  }
+  return _expanded_grid;
+}
+
+bool Space::isSparse() const {
+  return _sparse;
+}
+
+bool Space::isSlab() const {
+  return _slab;
+}
+
+// returns the start of the slab in the whole grid, in top level voxels along x
+unsigned long Space::getSlabOffset() const {
+  return _slab_offset;
+}
+
+SlabLabels& Space::getSlabLabels(){
+  return _slab_labels;
+}
+
+// returns the maximum distance, in top level voxels along any axis, between a voxel and the
+// neighbours that are assessed in the search for the cores of a probe with the given radius
+unsigned long Space::calcSearchReach(const double r_probe) const {
+  unsigned long reach = 0;
+  for (int lvl = 0; lvl <= _max_depth; ++lvl){
+    const unsigned long vxl_per_top = pow2(_max_depth-lvl);
+    const unsigned long range = std::ceil(std::sqrt(SearchIndex::calcUppLim(r_probe, _grid_size, lvl)));
+    reach = std::max(reach, (range + vxl_per_top - 1)/vxl_per_top);
+  }
+  return reach;
+}
+
+// called when a voxel is split. the dense grids already contain all subvoxels
+void Space::allocateSubvoxels(const std::array<unsigned,3>& index, const int lvl, const Voxel& unsplit_vxl){
+  if (_sparse){
+    _sparse_grid.allocateSubvoxels(index, lvl, unsplit_vxl);
+  }
 }
 
 /////////////////
 // GET ELEMENT //
 /////////////////
 
+// single index in row-major order, regardless of the layout of the grid
 Voxel& Space::getVxlFromGrid(const unsigned int i, unsigned lvl){
-  return _grid[lvl].getElement(i);
+  const std::array<unsigned,3> n_elements = getGridstepsOnLvl<unsigned>(lvl);
+  const std::array<unsigned,3> index = {i % n_elements[0], (i / n_elements[0]) % n_elements[1], i / (n_elements[0] * n_elements[1])};
+  return getVxlFromGrid(index, lvl);
 }
 
 Voxel& Space::getVxlFromGrid(const unsigned int x, const unsigned int y, const unsigned int z, unsigned lvl){
+  if (_sparse){return _sparse_grid.getElement({x,y,z}, lvl);}
   return _grid[lvl].getElement(x,y,z);
 }
 
 Voxel& Space::getVxlFromGrid(const std::array<unsigned int,3> arr, unsigned lvl){
+  if (_sparse){return _sparse_grid.getElement(arr, lvl);}
   return _grid[lvl].getElement(arr);
 }
 
 Voxel& Space::getVxlFromGrid(const std::array<int,3> arr, unsigned lvl){
+  if (_sparse){return _sparse_grid.getElement({unsigned(arr[0]), unsigned(arr[1]), unsigned(arr[2])}, lvl);}
+  return _grid[lvl].getElement(arr);
+}
+
+const Voxel& Space::getVxlFromGrid(const std::array<unsigned int,3> arr, unsigned lvl) const {
+  if (_sparse){return _sparse_grid.getElement(arr, lvl);}
   return _grid[lvl].getElement(arr);
 }
 
@@ -608,6 +1411,52 @@ unsigned long Space::totalVxlOnLvl(const int lvl) const{
   return total;
 }
 
+////////////////
+// CAVITY IDS //
+////////////////
+
+// index of the palette of the block that contains the voxel
+size_t Space::calcPaletteIndex(const std::array<unsigned,3>& index, const int lvl) const {
+  const int shift = _palette_lvl - lvl;
+  return ((index[2] >> shift) * _n_palette_blocks[1] + (index[1] >> shift)) * _n_palette_blocks[0] + (index[0] >> shift);
+}
+
+// the ID is only written to the pure voxel, not to the voxels below it. the voxels below a pure
+// voxel are rarely asked for their ID, but often for their type, which is therefore passed down
+CavityID Space::getCavityID(const std::array<unsigned,3>& index, const int lvl) const {
+  return lookUpCavityID(findPureVxl(index, lvl).getLocalID(), index, lvl);
+}
+
+// converts the local ID of a voxel into the ID of its cavity
+CavityID Space::lookUpCavityID(const unsigned char local_id, const std::array<unsigned,3>& index, const int lvl) const {
+  if (local_id == 0){return 0;}
+  const CavityID id = _id_palettes[calcPaletteIndex(index, lvl)].ids[local_id-1];
+  return _stitched_ids.empty()? id : _stitched_ids[id];
+}
+
+// after the type assignment of a slab, its cavity IDs can be replaced by the IDs of the cavities in
+// the whole grid, so that the surfaces of cavities that span multiple slabs can be calculated.
+// stitched_ids[i] is the ID in the whole grid of the cavity with the ID i in the slab
+void Space::setStitchedCavityIDs(const std::vector<CavityID>& stitched_ids){
+  _stitched_ids = stitched_ids;
+}
+
+// returns the local ID of a cavity in the block that contains the voxel. the cavity is added to the
+// palette of the block if necessary. a palette holds at most 255 cavities. if a palette is full, the
+// voxel is not assigned to any cavity and the overflow is reported after the type assignment
+unsigned char Space::findLocalID(const CavityID id, const std::array<unsigned,3>& index, const int lvl){
+  if (id == 0){return 0;}
+  IDPalette& palette = _id_palettes[calcPaletteIndex(index, lvl)];
+  const auto it = std::find(palette.ids.begin(), palette.ids.end(), id);
+  if (it != palette.ids.end()){return (it - palette.ids.begin()) + 1;}
+  if (palette.ids.size() == 0b11111111){
+    palette.overflow = true;
+    return 0;
+  }
+  palette.ids.push_back(id);
+  return palette.ids.size();
+}
+
 ////////////////
 // PRINT GRID //
 ////////////////
@@ -684,7 +1533,7 @@ void Space::printGrid(){
       for(unsigned int x = x_min; x < x_max; x++){
         char to_print;
         if (disp_id){
-          to_print = ('0' + getVxlFromGrid(x,y,z, _max_depth-depth).getID());
+          to_print = ('0' + getCavityID({x,y,z}, _max_depth-depth));
         }
         else{
           to_print = (getVxlFromGrid(x,y,z,_max_depth-depth).getType() == 0b00000011)? 'A' : 'O';
@@ -727,3 +1576,10 @@ double SurfaceLUT::typeToArea(unsigned char type) {
 double SurfaceLUT::configToArea(unsigned char config) {
   return area_by_type[types_by_config[config]];
 }
+double SurfaceLUT::countsToArea(const TypeCounts& counts) {
+  double area = 0;
+  for (size_t type = 0; type < counts.size(); ++type){
+    area += counts[type] * area_by_type[type];
+  }
+  return area;
+}
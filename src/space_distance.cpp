@@ -0,0 +1,120 @@
+#include "space.h"
+#include "voxel.h"
+#include "controller.h"
+#include "threadpool.h"
+#include "misc.h"
+#include <vector>
+
+/*
+The shell of a probe consists of the voxels that are within reach of a probe core voxel. The
+neighbour search (Voxel::searchForCore) scans all voxels within the search range of every voxel,
+whose number grows with the cube of the probe radius. This becomes slow for large probes on fine
+grids.
+
+Instead, the squared distance of every bottom level voxel to the closest probe core voxel can be
+computed with a distance transform, whose runtime only depends on the number of voxels. A bottom
+level voxel belongs to the shell, if this distance is within the search limit of the bottom level.
+This is the same criterion that the neighbour search applies on the bottom level, so that both
+give the same types for the bottom level voxels. A shell voxel belongs to the cavity of the first
+core voxel at this distance in the order of the neighbour search. Afterwards, the types of the
+voxels above the bottom level are merged from their subvoxels.
+
+The distance transform requires the dense grid and one additional 32 bit value per bottom level
+voxel.
+*/
+
+template<bool t_masking_mode>
+void Space::assignShellVsVoidByDistance(const std::array<unsigned long,2>& eval_top_x){
+  ThreadPool pool(_n_threads);
+  const std::array<unsigned,3> n_bot = getGridstepsOnLvl<unsigned>(0);
+
+  // distances to the probe core voxels
+  DistanceTransform dist(n_bot, Voxel::getSqrSearchLim(0));
+  pool.parallelFor(n_bot[2],
+    [&](const size_t z, const unsigned){
+      std::array<unsigned,3> index = {0, 0, unsigned(z)};
+      for (index[1] = 0; index[1] < n_bot[1]; ++index[1]){
+        for (index[0] = 0; index[0] < n_bot[0]; ++index[0]){
+          if (_grid[0].getElement(index).isProbeCore<t_masking_mode>()){dist.setFeature(index);}
+        }
+      }
+    });
+  if (Ctrl::getInstance()->getAbortFlag()){return;}
+  dist.compute(pool);
+  if (Ctrl::getInstance()->getAbortFlag()){return;}
+
+  // the bottom level voxels are processed in strips along x that are one palette block wide, so
+  // that every palette is only modified by one thread. voxels outside the evaluated range of a
+  // slab are left unassigned, like in the neighbour search
+  const unsigned strip_width = 1u << _palette_lvl;
+  const unsigned x_begin = eval_top_x[0] << _max_depth;
+  const unsigned x_end = eval_top_x[1] << _max_depth;
+  const size_t n_strips = (n_bot[0] + strip_width - 1) / strip_width;
+  auto for_each_unassigned = [&](const size_t strip, const auto& func){
+    std::array<unsigned,3> index;
+    for (index[2] = 0; index[2] < n_bot[2]; ++index[2]){
+      for (index[1] = 0; index[1] < n_bot[1]; ++index[1]){
+        for (index[0] = std::max<unsigned>(strip * strip_width, x_begin);
+            index[0] < std::min<unsigned>((strip+1) * strip_width, x_end); ++index[0]){
+          Voxel& vxl = _grid[0].getElement(index);
+          if (!vxl.isAssigned()){func(vxl, index);}
+        }
+      }
+    }
+  };
+
+  // the cavities of the shell voxels are found first, since this reads the palettes of other
+  // blocks. 0 marks a voxel without a core voxel in range, otherwise the cavity ID plus one
+  std::vector<std::vector<CavityID>> strip_results(n_strips);
+  pool.parallelFor(n_strips,
+    [&](const size_t strip, const unsigned){
+      if (Ctrl::getInstance()->getAbortFlag()){return;}
+      for_each_unassigned(strip, [&](Voxel&, const std::array<unsigned,3>& index){
+        const DistanceTransform::value_type sqr_dist = dist.getValue(index);
+        if (sqr_dist > dist.getLimit()){
+          strip_results[strip].push_back(0);
+        }
+        else {
+          strip_results[strip].push_back(t_masking_mode? 1 : findClosestCoreID(dist, index) + 1);
+        }
+      });
+    },
+    makeProgressReporter(n_strips));
+  if (Ctrl::getInstance()->getAbortFlag()){return;}
+
+  pool.parallelFor(n_strips,
+    [&](const size_t strip, const unsigned){
+      size_t i = 0;
+      for_each_unassigned(strip, [&](Voxel& vxl, const std::array<unsigned,3>& index){
+        const CavityID result = strip_results[strip][i++];
+        vxl.evalCoreDistance<t_masking_mode>(result != 0);
+        if (result != 0 && !t_masking_mode){
+          vxl.setLocalID(findLocalID(result - 1, index, 0));
+        }
+      });
+      std::vector<CavityID>().swap(strip_results[strip]);
+    });
+
+  // merge the types of the voxels above the bottom level
+  pool.parallelFor(totalVxlOnLvl(_max_depth),
+    [&](const size_t i, const unsigned){
+      const std::array<unsigned,3> top_index = calcTopIndex(i);
+      if (top_index[0] < eval_top_x[0] || top_index[0] >= eval_top_x[1]){return;}
+      getTopVxl(top_index).mergeSubvoxels(top_index, _max_depth);
+    });
+}
+
+template void Space::assignShellVsVoidByDistance<false>(const std::array<unsigned long,2>&);
+template void Space::assignShellVsVoidByDistance<true>(const std::array<unsigned long,2>&);
+
+// returns the cavity of the core voxel that the neighbour search finds first for a voxel, i.e.,
+// the first core voxel in the shell of search indices at the distance of the closest core voxel
+CavityID Space::findClosestCoreID(const DistanceTransform& dist, const std::array<unsigned,3>& index){
+  for (const std::array<int,3>& rel_index : Voxel::getSearchShell(dist.getValue(index))){
+    const std::array<int,3> nb_index = add(rel_index, index);
+    if (!isInBounds(nb_index, 0)){continue;}
+    const std::array<unsigned,3> core_index = {unsigned(nb_index[0]), unsigned(nb_index[1]), unsigned(nb_index[2])};
+    if (dist.isFeature(core_index)){return getCavityID(core_index, 0);}
+  }
+  return 0;
+}
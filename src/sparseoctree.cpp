@@ -0,0 +1,57 @@
+#include "sparseoctree.h"
+#include <bit>
+#include <cassert>
+
+/////////////////
+// CONSTRUCTOR //
+/////////////////
+
+SparseOctree::SparseOctree(const std::array<unsigned long,3>& n_top_lvl_vxl, const int max_depth)
+  : _top_lvl(n_top_lvl_vxl), _max_depth(max_depth) {}
+
+SparseOctree::Block::Block(const Voxel& vxl){
+  subvoxels.fill(vxl);
+}
+
+////////////
+// ACCESS //
+////////////
+
+// adds the subvoxels of a voxel that is being split. the subvoxels are initialised with the type
+// and ID that the voxel had before it was split, which is the state they would have in a dense grid
+void SparseOctree::allocateSubvoxels(const std::array<unsigned,3>& index, const int lvl, const Voxel& unsplit_vxl){
+  if (lvl == 0){return;}
+  const int n_lvl_below_top = _max_depth - lvl;
+  TopVoxel& top = _top_lvl.getElement(
+      index[0] >> n_lvl_below_top, index[1] >> n_lvl_below_top, index[2] >> n_lvl_below_top);
+  if (n_lvl_below_top == 0){
+    assert(top.children == nullptr);
+    top.children = top.allocate(Block(unsplit_vxl));
+    return;
+  }
+
+  // find the block that stores the voxel
+  Block* block = top.children;
+  for (int shift = n_lvl_below_top-1; shift > 0; --shift){
+    block = block->children[calcOctant(index, shift)];
+  }
+  Block*& children = block->children[calcOctant(index, 0)];
+  assert(children == nullptr);
+  children = top.allocate(Block(unsplit_vxl));
+}
+
+size_t SparseOctree::estimateMemory(const size_t n_top, const size_t n_split){
+  return n_top * sizeof(TopVoxel) + n_split * sizeof(Block);
+}
+
+// chunk k holds 2^k blocks
+SparseOctree::Block* SparseOctree::TopVoxel::allocate(const Block& block){
+  const unsigned chunk = std::bit_width(n_blocks+1) - 1;
+  if (chunk == chunks.size()){
+    chunks.emplace_back();
+    chunks.back().reserve(size_t(1) << chunk);
+  }
+  chunks[chunk].push_back(block);
+  ++n_blocks;
+  return &chunks[chunk].back();
+}
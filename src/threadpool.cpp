@@ -0,0 +1,142 @@
+#include "threadpool.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+
+//////////////////
+// WORK SHARING //
+//////////////////
+
+// range of loop iterations owned by one thread. the owner takes iterations from the front,
+// thieves take them from the back
+struct WorkRange{
+  std::mutex lock;
+  size_t begin = 0;
+  size_t end = 0;
+
+  size_t remaining(){
+    std::lock_guard<std::mutex> guard(lock);
+    return end - begin;
+  }
+};
+
+// takes the next iteration from the front of a range. returns false if the range is empty
+bool popFront(WorkRange& range, size_t& i){
+  std::lock_guard<std::mutex> guard(range.lock);
+  if (range.begin >= range.end){return false;}
+  i = range.begin++;
+  return true;
+}
+
+// moves the back half of the largest range of another thread into the (empty) range of
+// thread t. returns false if there is no work left to steal
+bool steal(std::vector<WorkRange>& ranges, const unsigned t){
+  while (true){
+    unsigned victim = t;
+    size_t max_remaining = 0;
+    for (unsigned v = 0; v < ranges.size(); ++v){
+      if (v == t){continue;}
+      size_t remaining = ranges[v].remaining();
+      if (remaining > max_remaining){
+        max_remaining = remaining;
+        victim = v;
+      }
+    }
+    if (victim == t){return false;}
+
+    std::scoped_lock guard(ranges[victim].lock, ranges[t].lock);
+    // the victim may have progressed since it was chosen
+    if (ranges[victim].begin >= ranges[victim].end){continue;}
+    size_t mid = ranges[victim].begin + (ranges[victim].end - ranges[victim].begin)/2;
+    ranges[t].begin = mid;
+    ranges[t].end = ranges[victim].end;
+    ranges[victim].end = mid;
+    return true;
+  }
+}
+
+/////////////////
+// CONSTRUCTOR //
+/////////////////
+
+ThreadPool::ThreadPool(const unsigned n_threads) : _n_threads(validateNumThreads(n_threads)) {}
+
+// zero requests all available hardware threads
+unsigned ThreadPool::validateNumThreads(const unsigned n_threads){
+  if (n_threads != 0){return n_threads;}
+  const unsigned n_hardware = std::thread::hardware_concurrency();
+  return n_hardware? n_hardware : 1;
+}
+
+unsigned ThreadPool::getNumThreads() const {
+  return _n_threads;
+}
+
+//////////////////
+// PARALLEL FOR //
+//////////////////
+
+void ThreadPool::parallelFor(const size_t n, const task_type& task, const progress_type& progress) const {
+  if (n == 0){return;}
+  // serial execution in the original loop order
+  if (_n_threads == 1 || n == 1){
+    for (size_t i = 0; i < n; ++i){
+      task(i, 0);
+      if (progress){progress(i+1);}
+    }
+    return;
+  }
+
+  const unsigned n_threads = (n < _n_threads)? n : _n_threads;
+  std::vector<WorkRange> ranges(n_threads);
+  for (unsigned t = 0; t < n_threads; ++t){
+    ranges[t].begin = (n * t) / n_threads;
+    ranges[t].end = (n * (t+1)) / n_threads;
+  }
+
+  std::atomic<size_t> n_done = 0;
+  std::exception_ptr error = nullptr;
+  std::mutex error_lock;
+
+  auto work = [&](const unsigned t){
+    try {
+      size_t i;
+      do {
+        while (popFront(ranges[t], i)){
+          task(i, t);
+          size_t done = ++n_done;
+          if (t == 0 && progress){progress(done);}
+        }
+      } while (steal(ranges, t));
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> guard(error_lock);
+      if (!error){error = std::current_exception();}
+      // stop all other threads from picking up new work
+      for (WorkRange& range : ranges){
+        std::lock_guard<std::mutex> range_guard(range.lock);
+        n_done += range.end - range.begin;
+        range.end = range.begin;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 1; t < n_threads; ++t){
+    workers.emplace_back(work, t);
+  }
+  work(0);
+  // keep reporting progress from the calling thread until all other threads are done
+  while (progress && n_done < n){
+    progress(n_done);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  for (std::thread& worker : workers){
+    worker.join();
+  }
+  if (progress){progress(n);}
+  if (error){std::rethrow_exception(error);}
+}
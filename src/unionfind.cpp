@@ -0,0 +1,51 @@
+#include "unionfind.h"
+#include <utility>
+
+/////////////////
+// CONSTRUCTOR //
+/////////////////
+
+UnionFind::UnionFind(const size_t n) : _parent(n) {
+  for (size_t i = 0; i < n; ++i){
+    _parent[i].store(i, std::memory_order_relaxed);
+  }
+}
+
+size_t UnionFind::size() const {
+  return _parent.size();
+}
+
+////////////////
+// OPERATIONS //
+////////////////
+
+size_t UnionFind::find(size_t i){
+  size_t parent = _parent[i].load();
+  while (parent != i){
+    // path halving. if another thread has changed the entry in the meantime, the entry is
+    // left as it is, since both values point to an ancestor of i
+    const size_t grandparent = _parent[parent].load();
+    _parent[i].compare_exchange_weak(parent, grandparent);
+    i = parent;
+    parent = _parent[i].load();
+  }
+  return i;
+}
+
+void UnionFind::unite(size_t a, size_t b){
+  while (true){
+    a = find(a);
+    b = find(b);
+    if (a == b){return;}
+    // the larger root is attached to the smaller root
+    if (a < b){std::swap(a,b);}
+    size_t expected = a;
+    // fails if a has been attached to another root since it was found, in which case the
+    // roots are looked up again
+    if (_parent[a].compare_exchange_strong(expected, b)){return;}
+  }
+}
+
+bool UnionFind::isRoot(const size_t i) const {
+  return _parent[i].load() == i;
+}
@@ -12,8 +12,8 @@
 // AUX FUNCTIONS //
 ///////////////////
 
-inline double Voxel::calcVxlRadius(const double& max_depth){
-  return max_depth != 0 ? 0.86602540378 * s_cell->getVxlSize() * (pow(2,max_depth) - 1) : 0;
+double Voxel::calcVxlRadius(const int lvl){
+  return lvl != 0 ? 0.86602540378 * s_cell->getVxlSize() * (pow(2,lvl) - 1) : 0;
 }
 char mergeTypes(std::vector<Voxel*>&);
 char mergeTypes(const std::array<char,8>&);
@@ -45,12 +45,19 @@ SearchIndex::SearchIndex(const double r_probe, const double grid_size, const uns
     // squared max distance between neighbours, where voxels do not have to be split
     _safe_lim[lvl] = (0 > max_dist - 2*vxl_radius)? 0 : std::pow( max_dist - (2*vxl_radius) , 2);
     // squared max distance between neighbours, that need to be assessed
-    _upp_lim[lvl] = std::pow( max_dist + 2*vxl_radius , 2);
+    _upp_lim[lvl] = calcUppLim(r_probe, grid_size, lvl);
   }
   unsigned int max_element = *std::max_element(_upp_lim.begin(), _upp_lim.end());
   _index_list = computeIndices(max_element);
 }
 
+// squared max distance between neighbours, that need to be assessed, in units of voxel side length at lvl
+unsigned int SearchIndex::calcUppLim(const double r_probe, const double grid_size, const unsigned int lvl){
+  double max_dist = r_probe/(grid_size*std::pow(2,lvl)) + std::sqrt(2)/4;
+  double vxl_radius = std::sqrt(3) * (1-1/std::pow(2,lvl));
+  return std::pow( max_dist + 2*vxl_radius , 2);
+}
+
 // access
 const std::vector<std::array<int,3>>& SearchIndex::operator[](unsigned int i){
   return _index_list[i];
@@ -176,77 +183,124 @@ Voxel& Voxel::getSubvoxel(std::array<unsigned,3> sub_index, const unsigned p_lvl
   return s_cell->getVxlFromGrid(sub_index,p_lvl-1);
 }
 
-bool Voxel::hasSubvoxel(){return readBit(_type,7);}
-bool Voxel::isCore(){return readBit(_type,3);}
-bool Voxel::isAssigned(){return readBit(_type,0);}
+bool Voxel::isCore() const {return readBit(_type,3);}
+bool Voxel::isAssigned() const {return readBit(_type,0);}
 
 // type
-char Voxel::getType() const {return _type;}
 void Voxel::setType(char input){_type = input;}
 
 // ID
-void Voxel::setID(unsigned char id){_identity = id;}
-unsigned char Voxel::getID() const {return _identity;}
+void Voxel::setLocalID(unsigned char id){_identity = id;}
+unsigned char Voxel::getLocalID() const {return _identity;}
 
 /////////////////////////////////
 // TYPE ASSIGNMENT PREPARATION //
 /////////////////////////////////
 
 // function to call before beginning the type assignment routine in order to prepare static variables
-void Voxel::prepareTypeAssignment(Space* cell, std::vector<Atom>& atoms){
+// the atom index is built for the largest probe radius of the calculation
+void Voxel::prepareTypeAssignment(Space* cell, std::vector<Atom>& atoms, const double r_probe, const mvINDEX index_type, const mvPRECISION precision){
   s_cell = cell;
-  delete s_atomtree;
-  s_atomtree = new AtomTree(atoms);
+  s_atom_index = AtomIndex::create(atoms, r_probe, index_type);
+  s_precision = precision;
 }
 
-void Voxel::storeProbe(const double r_probe, const bool masking_mode){
+// the geometry of every level is computed here, since the max depth and the grid step may change
+// between calculations
+void Voxel::storeProbe(const double r_probe){
   s_r_probe = r_probe;
-  s_masking_mode = masking_mode;
   s_search_indices = SearchIndex(r_probe, s_cell->getVxlSize(), s_cell->getMaxDepth());
+  s_lvl_geometry.assign(s_cell->getMaxDepth() + 1, {0, 0, -1});
+  double max_coord = 0;
+  for (char dim = 0; dim < 3; ++dim){
+    max_coord = std::max({max_coord, std::abs(s_cell->getMin()[dim]), std::abs(s_cell->getMax()[dim])});
+  }
+  for (int lvl = 0; lvl <= s_cell->getMaxDepth(); ++lvl){
+    s_lvl_geometry[lvl].rad_vxl = calcVxlRadius(lvl);
+    if (lvl == 0){continue;}
+    s_lvl_geometry[lvl].sub_offset = s_cell->getVxlSize() * std::pow(2,lvl-2);
+    // a child is related to an atom, if the atom is closer to the child's centre than its touch
+    // limit or, for negative probe radii, its partial limit. the distance to the parent's centre
+    // is larger by at most the offset between the centres. a margin covers rounding errors, which
+    // grow with the coordinates in single precision
+    const double offset = std::sqrt(3) * s_lvl_geometry[lvl].sub_offset;
+    const double rad_select = (offset + calcVxlRadius(lvl-1)) + std::max(-r_probe, 0.0);
+    const double magnitude = max_coord + s_atom_index->getMaxRad() + std::abs(r_probe) + rad_select;
+    s_lvl_geometry[lvl].rad_select = rad_select + 1e-6 + (s_precision == mvPRECISION_SINGLE?
+        AtomKernel::calcRoundingMargin<float>(magnitude) : AtomKernel::calcRoundingMargin<double>(magnitude));
+  }
+}
+
+// maximum distance along any axis, in units of voxels on level lvl, between a voxel and the
+// neighbours that are assessed in the search for probe cores
+unsigned Voxel::getSearchRange(const unsigned lvl){
+  return std::ceil(std::sqrt(s_search_indices.getUppLim(lvl)));
 }
 ///////////////////////////////
 // TYPE ASSIGNMENT 1ST ROUND //
 ///////////////////////////////
 // part of the type assigment routine. first evaluation is only concerned with the relation between
-// voxels and atoms
-char Voxel::evalRelationToAtoms(const std::array<unsigned,3>& index_vxl, Vector pos_vxl, const int lvl){
+// voxels and atoms. the atoms are taken from the candidates of the parent voxel, if there are any,
+// and are otherwise searched in the atom index. while being classified, the atoms that may be related
+// to any of the voxel's children are selected as their candidates
+template<bool t_masking_mode>
+char Voxel::evalRelationToAtoms(const std::array<unsigned,3>& index_vxl, Vector pos_vxl, const int lvl, const AtomCandidates* candidates){
   if(Ctrl::getInstance()->getAbortFlag()){return 0;}
   if (isAssigned()) {return _type;}
-  if (!hasSubvoxel()) {
-    double rad_vxl = calcVxlRadius(lvl); // calculated every time, since max_depth may change (not expensive)
-    traverseTree(s_atomtree->getRoot(), s_atomtree->getMaxRad(), pos_vxl, rad_vxl, s_r_probe, lvl);
-    if (_type == 0){_type = s_masking_mode? 0b00100001 : 0b00001001;}
+  // a voxel that has been split in a previous pass keeps its type, but still selects the candidates
+  // for its children
+  const bool was_split = hasSubvoxel();
+  const Voxel unsplit_vxl = *this;
+  AtomCandidates sub_candidates;
+  const unsigned char relations = s_precision == mvPRECISION_SINGLE?
+    classifyAtoms<float>(pos_vxl, lvl, candidates, sub_candidates) :
+    classifyAtoms<double>(pos_vxl, lvl, candidates, sub_candidates);
+  if (!was_split) {
+    applyAtomRelations<t_masking_mode>(relations);
+    if (_type == 0){_type = ProbeTypes<t_masking_mode>::core;}
+    if (hasSubvoxel()) {s_cell->allocateSubvoxels(index_vxl, lvl, unsplit_vxl);}
   }
   if (hasSubvoxel()) {
-    splitVoxel(index_vxl, pos_vxl, lvl);
+    splitVoxel<t_masking_mode>(index_vxl, pos_vxl, lvl, &sub_candidates);
   }
   else {
     // voxel has been processed
     passTypeToChildren(index_vxl, lvl);
   }
+  if (s_precision == mvPRECISION_SINGLE) {getCandidates<float>().pop(sub_candidates.offset);}
+  else {getCandidates<double>().pop(sub_candidates.offset);}
   return _type;
 }
 
-// passes parent type to all children
-void Voxel::passTypeToChildren(const std::array<unsigned,3>& index, const int lvl){
-  if (lvl == 0){return;}
-  std::array<unsigned,3> sub_index;
-  for (char x = 0; x < 2; ++x){
-    sub_index[0] = index[0]*2 + x;
-    for (char y = 0; y < 2; ++y){
-      sub_index[1] = index[1]*2 + y;
-      for (char z = 0; z < 2; ++z){
-        sub_index[2] = index[2]*2 + z;
-
-        getSubvoxel(sub_index, lvl).setType(_type);
-        getSubvoxel(sub_index, lvl).passTypeToChildren(sub_index, lvl-1);
-      }
-    }
+// classifies a voxel against the candidates of its parent, if there are any, and otherwise against
+// the atoms in the atom index. the candidates of its children are pushed onto the stack of the
+// precision, except on the bottom level
+template<typename T>
+unsigned char Voxel::classifyAtoms(const Vector& pos_vxl, const int lvl, const AtomCandidates* candidates, AtomCandidates& sub_candidates){
+  AtomKernel::Stack<T>& stack = getCandidates<T>();
+  const LevelGeometry& geometry = s_lvl_geometry[lvl];
+  const AtomKernel::Query<T> query = {{T(pos_vxl[0]), T(pos_vxl[1]), T(pos_vxl[2])}, T(geometry.rad_vxl), T(s_r_probe)};
+  const T rad_select = geometry.rad_select;
+  sub_candidates = {stack.size(), 0};
+  unsigned char relations = mvREL_NONE;
+  if (!candidates) {
+    s_n_node_visits += s_atom_index->classifyVoxel(query, relations, rad_select, stack);
   }
+  else if (lvl == 0) {
+    relations = AtomKernel::classify(stack.getBucket(candidates->offset), candidates->n, query);
+  }
+  else {
+    const AtomKernel::Buffer<T> buffer = stack.reserve(candidates->n);
+    stack.push(AtomKernel::classifyAndSelect(stack.getBucket(candidates->offset), candidates->n, query, rad_select, buffer, relations));
+  }
+  sub_candidates.n = stack.size() - sub_candidates.offset;
+  return relations;
 }
 
-void Voxel::passIDtoChildren(const std::array<unsigned,3>& index, const int lvl){
-  if (lvl == 0){return;}
+// passes parent type to all children. the sparse octree does not store the children of voxels
+// that have not been split
+void Voxel::passTypeToChildren(const std::array<unsigned,3>& index, const int lvl){
+  if (lvl == 0 || s_cell->isSparse()){return;}
   std::array<unsigned,3> sub_index;
   for (char x = 0; x < 2; ++x){
     sub_index[0] = index[0]*2 + x;
@@ -255,15 +309,16 @@ void Voxel::passIDtoChildren(const std::array<unsigned,3>& index, const int lvl)
       for (char z = 0; z < 2; ++z){
         sub_index[2] = index[2]*2 + z;
 
-        getSubvoxel(sub_index, lvl).setID(_identity);
-        getSubvoxel(sub_index, lvl).passIDtoChildren(sub_index, lvl-1);
+        getSubvoxel(sub_index, lvl).setType(_type);
+        getSubvoxel(sub_index, lvl).passTypeToChildren(sub_index, lvl-1);
       }
     }
   }
 }
 
 // adds an array of size 8 to the voxel that contains 8 subvoxels and evaluates each subvoxel's type
-void Voxel::splitVoxel(const std::array<unsigned,3>& vxl_index, const Vector& vxl_pos, const double lvl){
+template<bool t_masking_mode>
+void Voxel::splitVoxel(const std::array<unsigned,3>& vxl_index, const Vector& vxl_pos, const int lvl, const AtomCandidates* candidates){
   // split into 8 subvoxels
   std::array<char,8> subtypes;
   std::array<unsigned,3> sub_index;
@@ -279,9 +334,9 @@ void Voxel::splitVoxel(const std::array<unsigned,3>& vxl_index, const Vector& vx
         sub_index[0] = vxl_index[0]*2 + x;
         factors[0] = x ? 1 : -1;
         // modify position
-        Vector new_pos = vxl_pos + factors * s_cell->getVxlSize() * std::pow(2,lvl-2);
+        Vector new_pos = vxl_pos + factors * s_lvl_geometry[lvl].sub_offset;
 
-        subtypes[i] = getSubvoxel(sub_index, lvl).evalRelationToAtoms(sub_index, new_pos, lvl-1);
+        subtypes[i] = getSubvoxel(sub_index, lvl).evalRelationToAtoms<t_masking_mode>(sub_index, new_pos, lvl-1, candidates);
         ++i;
 
       }
@@ -290,90 +345,28 @@ void Voxel::splitVoxel(const std::array<unsigned,3>& vxl_index, const Vector& vx
   setType(mergeTypes(subtypes));
 }
 
-// goes through all close atoms to determine a voxel's type
-void Voxel::traverseTree
-  (const AtomNode* node,
-   const double rad_max,
-   const Vector& pos_vxl,
-   const double rad_vxl,
-   const double rad_probe,
-   const int max_depth,
-   const char exit_type,
-   const char dim){
-
-  if (node == NULL){return;}
-  const Atom& atom = node->getAtom();
-
-  // distance between atom and voxel along one dimension
-  double dist1D = distance(atom.getPosVec(), pos_vxl, dim);
-
-  if (abs(dist1D) > (rad_vxl + rad_max + rad_probe)){ // then atom is too far to matter for voxel type
-      traverseTree(dist1D < 0 ? node->getLeftChild() : node->getRightChild(),
-          rad_max, pos_vxl, rad_vxl, rad_probe, max_depth, exit_type, (dim+1)%3);
-  }
-  else{ // then atom is close enough to influence voxel type
-    if(isAtom(atom, pos_vxl, rad_vxl, rad_probe)){return;}
-
-    // continue with both children
-    for (const AtomNode* child : {node->getLeftChild(), node->getRightChild()}){
-      traverseTree(child, rad_max, pos_vxl, rad_vxl, rad_probe, max_depth, exit_type, (dim+1)%3);
-    }
-  }
+// number of atom index nodes or cells that the current thread has visited since the last call
+unsigned long Voxel::takeNodeVisits(){
+  const unsigned long n_visits = s_n_node_visits;
+  s_n_node_visits = 0;
+  return n_visits;
 }
 
-// assign a type based on the distance between a voxel and an atom
-bool Voxel::isAtom(const Atom& atom, const Vector& pos_vxl, const double rad_vxl, const double rad_probe){
-  Vector dist = pos_vxl - atom.getPosVec();
-
-  if((dist < atom.getRad() - rad_vxl) && (0 < atom.getRad() - rad_vxl)){ // if completely inside atom
+// assign a type based on the relations between a voxel and all atoms. the relation with the
+// highest precedence determines the type, regardless of the order in which the atoms are visited
+template<bool t_masking_mode>
+void Voxel::applyAtomRelations(const unsigned char relations){
+  if (relations & mvREL_INSIDE){ // if completely inside atom
     _type = 0b00000011;
-    return true;
   }
-  else if (dist < atom.getRad() + rad_vxl){ // if partially inside atom
-    if (readBit(_type,1)){return false;} // if inside atom // TODO: this line may be unnecessary
+  else if (relations & mvREL_PARTIAL){ // if partially inside atom
     _type = 0b10000010;
   }
-  else if ((dist < atom.getRad() + rad_probe - rad_vxl) && (0 < atom.getRad() + rad_probe - rad_vxl)){ // if outside atom but not touching potential probe core
-    if (readBit(_type,1)){return false;} // if mixed or inside atom
-    _type = s_masking_mode? 0b01000000 : 0b00010000;
+  else if (relations & mvREL_SHELL){ // if outside atom but not touching potential probe core
+    _type = ProbeTypes<t_masking_mode>::near_atom;
   }
-  else if (dist < atom.getRad() + rad_probe + rad_vxl){ // if outside atom but touching potential probe core
-    if (readBit(_type,4) || readBit(_type,1)){return false;} // if mixed, inside atom, or potential shell
-    _type = s_masking_mode? 0b11000000 : 0b10010000;
-  }
-  return false;
-}
-
-// TODO: Remove, instead use AtomTree::listAllWithin()
-// go through a tree, starting from node. return a list of atoms that are a specified max distance
-// from a point with radius rad_point.
-void Voxel::listFromTree(
-  std::vector<int>& atom_id_list,
-  const AtomNode* node,
-  const Vector& pos_point,
-  const double& rad_point,
-  const double& rad_max, // ideally this value should be retrieved from node
-  const double& max_dist,
-  const char dim)
-{
-  if (node == NULL){return;}
-
-  // distance between atom and point along one dimension
-  double dist1D = distance(node->getAtom().getPosVec(), pos_point, dim);
-  double rad_atom = node->getAtom().getRad();
-
-  if (abs(dist1D) > rad_point + rad_max + max_dist) { // then atom is too far
-      listFromTree(atom_id_list, dist1D<0? node->getLeftChild() : node->getRightChild(), pos_point, rad_point, rad_max, max_dist, (dim+1)%3);
-  }
-  else { // then atom may be close enough
-    if ((pos_point-node->getAtom().getPosVec()) < rad_point + rad_atom + max_dist){
-      atom_id_list.push_back(node->getAtomId());
-    }
-
-    // continue with both children
-    for (const AtomNode* child : {node->getLeftChild(), node->getRightChild()}){
-      listFromTree(atom_id_list, child, pos_point, rad_point, rad_max, max_dist, (dim+1)%3);
-    }
+  else if (relations & mvREL_TOUCH){ // if outside atom but touching potential probe core
+    _type = ProbeTypes<t_masking_mode>::touching_atom;
   }
 }
 
@@ -381,99 +374,16 @@ void Voxel::listFromTree(
 // CAVITY ID //
 ///////////////
 
-struct VoxelLoc{
-  VoxelLoc() = default;
-  VoxelLoc(const std::array<unsigned,3>& index, const int lvl) : index(index), lvl(lvl), interface_vxl(false) {}
-  VoxelLoc(const std::array<unsigned,3>& index, const int lvl, const bool interface_vxl)
-    : index(index), lvl(lvl), interface_vxl(interface_vxl) {}
-  std::array<unsigned,3> index;
-  int lvl;
-  bool interface_vxl;
-};
-
-class FloodStack{
-  private:
-    std::vector<VoxelLoc> economy_lane;
-    std::vector<VoxelLoc> priority_lane;
-  public:
-    FloodStack() = default;
-    VoxelLoc popOut(){
-      VoxelLoc vxl;
-      if (priority_lane.empty()){
-        vxl = economy_lane.back();
-        vxl.interface_vxl = true;
-        economy_lane.pop_back();
-      }
-      else {
-        vxl = priority_lane.back();
-        priority_lane.pop_back();
-      }
-      return vxl;
-    }
-    size_t size() const {
-      return economy_lane.size() + priority_lane.size();
-    }
-    size_t sizePriority() const {
-      return priority_lane.size();
-    }
-    void pushBack(const VoxelLoc& vxl, const bool priority=false){
-      (priority? priority_lane : economy_lane).push_back(vxl);
-    }
-};
-
-// this function returns false when accessing an existing cavity and returns
-// true every time a new cavity has been processed
-bool Voxel::floodFill(std::vector<Cavity>& cavities, const unsigned char id, const std::array<unsigned,3>& start_index, const int start_lvl, const bool cavity_type){
-  if(getID() != 0){return false;}
-  // initialise flood fill stack
-  FloodStack stack;
-
-  // set the ID of the start voxel and all its children
-  setID(id);
-  passIDtoChildren(start_index, start_lvl);
-  // add first voxel to stack
-  stack.pushBack(VoxelLoc(start_index, start_lvl), 
-      cavity_type? isInterfaceVxl(VoxelLoc(start_index, start_lvl)) : false);
-  
-  int n_interface = 0;
-  bool at_interface = false;
-  while (stack.size() > 0){
-    if (Ctrl::getInstance()->getAbortFlag()){return false;}
-    Ctrl::getInstance()->updateCalculationStatus(); // checks for abort button click
-
-    // get the next voxel from the stack
-    VoxelLoc vxl = stack.popOut();
-
-    // get all pure small probe core neighbours of the current voxel. pure means the voxel is the highest
-    // level voxel that does not have mixed type
-    std::vector<VoxelLoc> all_core_nbs = findPureNeighbours(vxl, mvTYPE_SP_CORE, false);
-   
-    // go through all neighbours
-    for (const VoxelLoc& nb_loc : all_core_nbs){
-      // get a reference to the neighbour voxel
-      Voxel& nb_vxl = s_cell->getVxlFromGrid(nb_loc.index,nb_loc.lvl);
-      if (nb_vxl.getID()){continue;} // skip processed voxels
-      
-      nb_vxl.setID(id);
-      nb_vxl.passIDtoChildren(nb_loc.index, nb_loc.lvl);
-      stack.pushBack(nb_loc, cavity_type? isInterfaceVxl(nb_loc) : false);
-    }
-    
-    // increment interface count if we are entering interface mode
-    if (!at_interface && stack.sizePriority()){
-      n_interface++;
-    }
-    
-    // determines whether we are at a core-outside interface
-    at_interface = stack.sizePriority();
-  }
-  cavities.push_back(Cavity(id, n_interface));
-  return true;
+// appends all pure small probe core neighbours of a pure voxel to the vector. the vector is passed
+// in, so that it can be reused for every voxel of the cavity labelling
+void Voxel::findCoreNeighbours(std::vector<VoxelLoc>& core_nbs, const VoxelLoc& vxl){
+  findPureNeighbours(core_nbs, vxl, mvTYPE_SP_CORE, true);
 }
 
 bool Voxel::isInterfaceVxl(const VoxelLoc& vxl){
-  std::vector<VoxelLoc> outside_nbs = s_cell->getVxlFromGrid(vxl.index, vxl.lvl).findPureNeighbours(vxl, mvTYPE_LP_SHELL);
-  // if (nbs.size()){return true;}
+  static thread_local std::vector<VoxelLoc> outside_nbs;
+  outside_nbs.clear();
+  s_cell->getVxlFromGrid(vxl.index, vxl.lvl).findPureNeighbours(outside_nbs, vxl, mvTYPE_LP_SHELL);
   for (const VoxelLoc& nb : outside_nbs) {
     if (readBit(s_cell->getVxlFromGrid(nb.index, nb.lvl).getType(),6)){
       return true;
@@ -482,17 +392,13 @@ bool Voxel::isInterfaceVxl(const VoxelLoc& vxl){
   return false;
 }
 
-// returns a vector of all pure neighbours 
+// appends all pure neighbours to the vector
 // contains duplicates due to ascend
-std::vector<VoxelLoc> Voxel::findPureNeighbors(const VoxelLoc& central_vxl, const unsigned char type_flag, const bool any_id){
-  return findPureNeighbours(central_vxl, type_flag, any_id);
-}
-std::vector<VoxelLoc> Voxel::findPureNeighbours(const VoxelLoc& central_vxl, const unsigned char type_flag, const bool any_id){
+void Voxel::findPureNeighbours(std::vector<VoxelLoc>& all_pure_nbs, const VoxelLoc& central_vxl, const unsigned char type_flag, const bool any_id){
   // reusing SearchIndex to get a vector of all direct neighbour voxel indices, i.e.
   // (1,0,0); (1,0,1); (1,1,0), (1,1,1), etc.
   static const std::vector<std::vector<std::array<int,3>>> s_nb_indices = SearchIndex().computeIndices(3,false);
   
-  std::vector<VoxelLoc> all_pure_nbs;
   std::array<unsigned,3> nb_index;
   for (const auto& shell : s_nb_indices){
     for (const auto& rel_index : shell){
@@ -501,7 +407,7 @@ std::vector<VoxelLoc> Voxel::findPureNeighbours(const VoxelLoc& central_vxl, con
       if (!s_cell->isInBounds(nb_index,central_vxl.lvl)){continue;}
 
       Voxel& nb_vxl = s_cell->getVxlFromGrid(nb_index,central_vxl.lvl);
-      if (!any_id && nb_vxl.getID()){continue;} // greatly accelerates flood fill
+      if (!any_id && nb_vxl.getLocalID()){continue;} // greatly accelerates flood fill
       if (!(nb_vxl.getType() & type_flag)){continue;}
 
       if (nb_vxl.hasSubvoxel()){
@@ -514,7 +420,6 @@ std::vector<VoxelLoc> Voxel::findPureNeighbours(const VoxelLoc& central_vxl, con
       }
     }
   }
-  return all_pure_nbs;
 }
 
 void Voxel::descend(std::vector<VoxelLoc>& all_pure_nbs, const std::array<unsigned,3>& index, const int lvl, const std::array<int,3>& nb_relation, const unsigned char type_flag){
@@ -588,12 +493,15 @@ void Voxel::ascend(std::vector<VoxelLoc>& all_pure_nbs, const std::array<unsigne
 // TYPE ASSIGNMENT 2ND ROUND //
 ///////////////////////////////
 
+template<bool t_masking_mode>
 char Voxel::evalRelationToVoxels(const std::array<unsigned int,3>& index, const unsigned lvl, bool split){
   // if voxel (including all subvoxels) have been assigned, then return immediately
   if (Ctrl::getInstance()->getAbortFlag()){return 0;}
   if (isAssigned()){return _type;}
   else if (!hasSubvoxel()){ // vxl has no children
-    split = !searchForCore(index, lvl, split);
+    const Voxel unsplit_vxl = *this;
+    split = !searchForCore<t_masking_mode>(index, lvl, split);
+    if (hasSubvoxel()) {s_cell->allocateSubvoxels(index, lvl, unsplit_vxl);}
   }
   if (hasSubvoxel()) { // vxl has children
     std::array<unsigned int,3> index_subvxl;
@@ -605,7 +513,7 @@ char Voxel::evalRelationToVoxels(const std::array<unsigned int,3>& index, const
         index_subvxl[1] = index[1]*2 + y;
         for (char z = 0; z < 2; z++){
           index_subvxl[2] = index[2]*2 + z;
-          subtypes[i] = getSubvoxel(index_subvxl, lvl).evalRelationToVoxels(index_subvxl, lvl-1, split);
+          subtypes[i] = getSubvoxel(index_subvxl, lvl).evalRelationToVoxels<t_masking_mode>(index_subvxl, lvl-1, split);
           ++i;
         }
       }
@@ -616,35 +524,33 @@ char Voxel::evalRelationToVoxels(const std::array<unsigned int,3>& index, const
   return _type;
 }
 
+template<bool t_masking_mode>
 bool Voxel::searchForCore(const std::array<unsigned int,3>& index, const unsigned lvl, bool split){
   // the return value of this function is used to determine, whether after splitting this voxel,
   // the subsequent neighbour search should start from 0 or from the safe limit. The use of this
   // return value allows avoiding calling a function to validate voxel coordinates (Space::isInBounds)
   // which, due to the number of times the function would have to be called, saves a lot of computations
   bool next_search_from_0 = false;
-  _type = s_masking_mode? 0 : 0b00000101; // type excluded
-
-  const char shell_type = s_masking_mode? 0b01000001 : 0b00010001;
-  const char bit_pos_core = s_masking_mode? 5 : 3;
+  _type = ProbeTypes<t_masking_mode>::excluded;
 
   for (unsigned int n = (split? Voxel::s_search_indices.getSafeLim(lvl+1)*4 : 1); n <= Voxel::s_search_indices.getUppLim(lvl); ++n){
     // called very often; keep section inexpensive
     for (std::array<int,3> coord : Voxel::s_search_indices[n]){
       coord = add(coord,index);
       // if a neighbour voxel containing a probe core is found
-      if (readBit((s_cell->getVxlFromGrid(coord,lvl)).getType(),bit_pos_core)){
+      if (readBit((s_cell->getVxlFromGrid(coord,lvl)).getType(),ProbeTypes<t_masking_mode>::core_bit)){
         Voxel& nb_vxl = s_cell->getVxlFromGrid(coord,lvl);
         // if the neighbour is within a safe distance
         if (n <= Voxel::s_search_indices.getSafeLim(lvl)){
           next_search_from_0 = true;
-          setType(shell_type); // TODO: type is set only to be potentially reset
-          if (!s_masking_mode && nb_vxl.getType() != 0b00001001){
+          setType(ProbeTypes<t_masking_mode>::shell); // TODO: type is set only to be potentially reset
+          if (!t_masking_mode && nb_vxl.getType() != ProbeTypes<t_masking_mode>::core){
             setType(0b10000000);
           }
           else {
-            // voxel evaluation successful
-            setID(nb_vxl.getID());
-            passIDtoChildren(index, lvl);
+            // voxel evaluation successful. the neighbour may belong to a different block of the grid
+            const std::array<unsigned,3> nb_index = {unsigned(coord[0]), unsigned(coord[1]), unsigned(coord[2])};
+            setLocalID(s_cell->findLocalID(s_cell->getCavityID(nb_index, lvl), index, lvl));
           }
         }
         // if the neighbour is within a questionable distance
@@ -659,15 +565,63 @@ bool Voxel::searchForCore(const std::array<unsigned int,3>& index, const unsigne
   return next_search_from_0;
 }
 
+// the core of the current probe, i.e., of the large probe in masking mode
+template<bool t_masking_mode>
+bool Voxel::isProbeCore() const {
+  return readBit(_type, ProbeTypes<t_masking_mode>::core_bit);
+}
+
+// assigns the type of a bottom level voxel, depending on whether a probe core voxel lies within
+// the search range. this gives the same type as the neighbour search on the bottom level
+template<bool t_masking_mode>
+void Voxel::evalCoreDistance(const bool core_in_range){
+  _type = core_in_range? ProbeTypes<t_masking_mode>::shell : ProbeTypes<t_masking_mode>::excluded;
+}
+
+// after the bottom level voxels have been assigned, the types of the voxels above them are
+// merged from their subvoxels. a pure voxel remains pure if all its subvoxels have the same type
+// and belong to the same cavity. otherwise, it is split
+char Voxel::mergeSubvoxels(const std::array<unsigned,3>& index, const int lvl){
+  if (lvl == 0 || isAssigned()){return _type;}
+  std::array<char,8> subtypes;
+  bool uniform = true;
+  unsigned char local_id = 0;
+  std::array<unsigned,3> sub_index;
+  char i = 0;
+  for (char x = 0; x < 2; ++x){
+    sub_index[0] = index[0]*2 + x;
+    for (char y = 0; y < 2; ++y){
+      sub_index[1] = index[1]*2 + y;
+      for (char z = 0; z < 2; ++z){
+        sub_index[2] = index[2]*2 + z;
+        Voxel& sub_vxl = getSubvoxel(sub_index, lvl);
+        subtypes[i] = sub_vxl.mergeSubvoxels(sub_index, lvl-1);
+        // all levels of a top level voxel share the same palette of cavity IDs
+        if (i == 0){local_id = sub_vxl.getLocalID();}
+        uniform &= !sub_vxl.hasSubvoxel() && subtypes[i] == subtypes[0] && sub_vxl.getLocalID() == local_id;
+        ++i;
+      }
+    }
+  }
+  if (!hasSubvoxel() && uniform){
+    _type = subtypes[0];
+    _identity = local_id;
+  }
+  else {
+    setType(mergeTypes(subtypes));
+  }
+  return _type;
+}
+
 ///////////
 // TALLY //
 ///////////
 
 void Voxel::tallyVoxelsOfType(std::map<char,double>& type_tally,
-    std::map<unsigned char,double>& id_core_tally,
-    std::map<unsigned char,double>& id_shell_tally,
-    std::map<unsigned char,std::array<unsigned,3>>& id_min,
-    std::map<unsigned char,std::array<unsigned,3>>& id_max,
+    std::map<CavityID,double>& id_core_tally,
+    std::map<CavityID,double>& id_shell_tally,
+    std::map<CavityID,std::array<unsigned,3>>& id_min,
+    std::map<CavityID,std::array<unsigned,3>>& id_max,
     const std::array<unsigned,3>& index,
     const int lvl,
     const double vxl_fraction)
@@ -691,11 +645,13 @@ void Voxel::tallyVoxelsOfType(std::map<char,double>& type_tally,
   else {
     // tally number of bottom level voxels
     type_tally[getType()] += pow(pow2(lvl),3) * vxl_fraction;
+    // the voxel may lie below the pure voxel that holds the ID, e.g., in the unit cell tally
+    const CavityID id = s_cell->getCavityID(index, lvl);
     if(getType() == 0b00001001){
-      id_core_tally[getID()] += pow(pow2(lvl),3) * vxl_fraction;
+      id_core_tally[id] += pow(pow2(lvl),3) * vxl_fraction;
     }
     else if(getType() == 0b00010001){
-      id_shell_tally[getID()] += pow(pow2(lvl),3) * vxl_fraction;
+      id_shell_tally[id] += pow(pow2(lvl),3) * vxl_fraction;
     }
     // localise cavities
     std::array<unsigned,3> min;
@@ -704,11 +660,11 @@ void Voxel::tallyVoxelsOfType(std::map<char,double>& type_tally,
       min[i] = index[i]*pow2(lvl);
       max[i] = ((index[i]+1)*pow2(lvl))-1;
     }
-    if (id_min.count(getID()) == 0) {id_min[getID()] = min;}
-    if (id_max.count(getID()) == 0) {id_max[getID()] = max;}
+    if (id_min.count(id) == 0) {id_min[id] = min;}
+    if (id_max.count(id) == 0) {id_max[id] = max;}
     for (char i = 0; i < 3; i++){
-      if (id_min[getID()][i] > min[i]) {id_min[getID()][i] = min[i];}
-      if (id_max[getID()][i] < max[i]) {id_max[getID()][i] = max[i];}
+      if (id_min[id][i] > min[i]) {id_min[id][i] = min[i];}
+      if (id_max[id][i] < max[i]) {id_max[id][i] = max[i];}
     }
   }
 }
@@ -743,3 +699,12 @@ char mergeTypes(std::vector<Voxel*>& sub_vxls){
   return parent_type;
 }
 
+// the passes of the type assignment are instantiated for the small probe and the masking mode
+template char Voxel::evalRelationToAtoms<false>(const std::array<unsigned,3>&, Vector, const int, const AtomCandidates*);
+template char Voxel::evalRelationToAtoms<true>(const std::array<unsigned,3>&, Vector, const int, const AtomCandidates*);
+template char Voxel::evalRelationToVoxels<false>(const std::array<unsigned int,3>&, const unsigned, bool);
+template char Voxel::evalRelationToVoxels<true>(const std::array<unsigned int,3>&, const unsigned, bool);
+template bool Voxel::isProbeCore<false>() const;
+template bool Voxel::isProbeCore<true>() const;
+template void Voxel::evalCoreDistance<false>(const bool);
+template void Voxel::evalCoreDistance<true>(const bool);
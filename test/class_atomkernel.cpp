@@ -0,0 +1,140 @@
+#include "atomkernel.h"
+#include "flags.h"
+#include <vector>
+#include <random>
+#include <algorithm>
+
+// Using this macro for future compatibility with Catch2
+# define REQUIRE(x) if (!(x)) return -1;
+
+int main() {
+
+  // TEST: Relations of a single atom
+  // The voxel radius is 0.5 and the probe radius is 2. The atom with radius 2 lies on the x-axis.
+  {
+    const std::vector<double> y = {0}, z = {0}, rad = {2};
+    auto classify_at = [&](const double x){
+      const std::vector<double> x_vec = {x};
+      return AtomKernel::classifyScalar<double>({x_vec.data(), y.data(), z.data(), rad.data()}, 1, {{0,0,0}, 0.5, 2});
+    };
+    REQUIRE(classify_at(1) == (mvREL_INSIDE | mvREL_PARTIAL | mvREL_SHELL | mvREL_TOUCH));
+    REQUIRE(classify_at(2) == (mvREL_PARTIAL | mvREL_SHELL | mvREL_TOUCH));
+    REQUIRE(classify_at(3) == (mvREL_SHELL | mvREL_TOUCH));
+    REQUIRE(classify_at(4) == mvREL_TOUCH);
+    REQUIRE(classify_at(5) == mvREL_NONE);
+  }
+
+  // TEST: The implementation selected at runtime agrees with the scalar implementation
+  // Buckets of all sizes up to 17 atoms are tested, so that the last, partially filled SIMD
+  // register is covered. The atoms are read from the middle of larger arrays, whose other
+  // elements are placed right at the voxel and would be classified as inside, if they were read.
+  {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> coord(-4, 4), radius(0.5, 2.5), voxel(0, 1.5);
+    for (size_t n = 0; n <= 17; ++n) {
+      for (int rep = 0; rep < 200; ++rep) {
+        const size_t offset = 3;
+        std::vector<double> x(n + 2*offset, 0), y(n + 2*offset, 0), z(n + 2*offset, 0), rad(n + 2*offset, 3);
+        for (size_t i = offset; i < offset + n; ++i) {
+          x[i] = coord(gen);
+          y[i] = coord(gen);
+          z[i] = coord(gen);
+          rad[i] = radius(gen);
+        }
+        const AtomKernel::Bucket<double> bucket = {&x[offset], &y[offset], &z[offset], &rad[offset]};
+        const AtomKernel::Query<double> query = {{coord(gen)/2, coord(gen)/2, coord(gen)/2}, voxel(gen), voxel(gen)};
+        REQUIRE(AtomKernel::classify(bucket, n, query) == AtomKernel::classifyScalar(bucket, n, query));
+      }
+    }
+  }
+
+  // TEST: Selecting atoms while classifying
+  // The relations agree with classify and both implementations select the same atoms, in the
+  // order of the bucket, into a buffer taken from the top of a stack.
+  {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> coord(-4, 4), radius(0.5, 2.5), voxel(0, 1.5);
+    AtomKernel::Stack<double> stack;
+    for (size_t n = 0; n <= 17; ++n) {
+      for (int rep = 0; rep < 200; ++rep) {
+        std::vector<double> x(n), y(n), z(n), rad(n);
+        for (size_t i = 0; i < n; ++i) {
+          x[i] = coord(gen);
+          y[i] = coord(gen);
+          z[i] = coord(gen);
+          rad[i] = radius(gen);
+        }
+        const AtomKernel::Bucket<double> bucket = {x.data(), y.data(), z.data(), rad.data()};
+        const AtomKernel::Query<double> query = {{coord(gen)/2, coord(gen)/2, coord(gen)/2}, voxel(gen), voxel(gen)};
+        const double rad_select = voxel(gen);
+
+        std::vector<double> expected_x;
+        for (size_t i = 0; i < n; ++i) {
+          const double dx = query.pos[0] - x[i], dy = query.pos[1] - y[i], dz = query.pos[2] - z[i];
+          const double lim_select = (rad[i] + query.rad_probe) + rad_select;
+          if ((dx*dx + dy*dy) + dz*dz < lim_select*lim_select) {expected_x.push_back(x[i]);}
+        }
+
+        std::vector<double> out_x(n), out_y(n), out_z(n), out_rad(n);
+        unsigned char relations_scalar = mvREL_NONE;
+        const size_t n_scalar = AtomKernel::classifyAndSelectScalar
+          (bucket, n, query, rad_select, {out_x.data(), out_y.data(), out_z.data(), out_rad.data()}, relations_scalar);
+        REQUIRE(n_scalar == expected_x.size());
+        REQUIRE(std::equal(expected_x.begin(), expected_x.end(), out_x.begin()));
+        REQUIRE(relations_scalar == AtomKernel::classifyScalar(bucket, n, query));
+
+        const size_t base = stack.size();
+        unsigned char relations = mvREL_NONE;
+        stack.push(AtomKernel::classifyAndSelect(bucket, n, query, rad_select, stack.reserve(n), relations));
+        REQUIRE(relations == relations_scalar);
+        REQUIRE(stack.size() - base == n_scalar);
+        const AtomKernel::Bucket<double> selected = stack.getBucket(base);
+        for (size_t i = 0; i < n_scalar; ++i) {
+          REQUIRE(selected.x[i] == out_x[i]);
+          REQUIRE(selected.y[i] == out_y[i]);
+          REQUIRE(selected.z[i] == out_z[i]);
+          REQUIRE(selected.rad[i] == out_rad[i]);
+        }
+        // keep some of the atoms on the stack, so that it has to grow
+        if (rep % 2) {stack.pop(base);}
+      }
+    }
+  }
+
+  // TEST: Single precision
+  // The implementation selected at runtime agrees with the scalar implementation in single
+  // precision, which holds twice as many atoms per SIMD register. Buckets of up to 33 atoms
+  // cover the last, partially filled register.
+  {
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> coord(-4, 4), radius(0.5, 2.5), voxel(0, 1.5);
+    AtomKernel::Stack<float> stack;
+    for (size_t n = 0; n <= 33; ++n) {
+      for (int rep = 0; rep < 200; ++rep) {
+        std::vector<float> x(n), y(n), z(n), rad(n);
+        for (size_t i = 0; i < n; ++i) {
+          x[i] = coord(gen);
+          y[i] = coord(gen);
+          z[i] = coord(gen);
+          rad[i] = radius(gen);
+        }
+        const AtomKernel::Bucket<float> bucket = {x.data(), y.data(), z.data(), rad.data()};
+        const AtomKernel::Query<float> query = {{coord(gen)/2, coord(gen)/2, coord(gen)/2}, voxel(gen), voxel(gen)};
+        const float rad_select = voxel(gen);
+        REQUIRE(AtomKernel::classify(bucket, n, query) == AtomKernel::classifyScalar(bucket, n, query));
+
+        std::vector<float> out_x(n), out_y(n), out_z(n), out_rad(n);
+        unsigned char relations_scalar = mvREL_NONE;
+        const size_t n_scalar = AtomKernel::classifyAndSelectScalar
+          (bucket, n, query, rad_select, {out_x.data(), out_y.data(), out_z.data(), out_rad.data()}, relations_scalar);
+        unsigned char relations = mvREL_NONE;
+        stack.pop(0);
+        stack.push(AtomKernel::classifyAndSelect(bucket, n, query, rad_select, stack.reserve(n), relations));
+        REQUIRE(relations == relations_scalar);
+        REQUIRE(stack.size() == n_scalar);
+        REQUIRE(std::equal(out_x.begin(), out_x.begin() + n_scalar, stack.getBucket(0).x));
+        REQUIRE(std::equal(out_rad.begin(), out_rad.begin() + n_scalar, stack.getBucket(0).rad));
+      }
+    }
+  }
+}
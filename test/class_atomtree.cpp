@@ -1,5 +1,6 @@
 #include "atom.h"
 #include "atomtree.h"
+#include "misc.h"
 #include <vector>
 #include <iostream>
 #include <map>
@@ -8,6 +9,7 @@
 # define REQUIRE(x) if (!x) return -1;
 
 std::vector<Atom> isobutane();
+std::vector<Atom> lattice(const int);
 //std::vector<Atom> protein_6s8y();
 
 int main() {
@@ -42,31 +44,95 @@ int main() {
   // are arranged depends on the depth and alternates cyclically as the depth
   // increases. In this 3-d tree the first axis is the x-axis and is followed by
   // the y- then z-axis.
-  // This test checks the spatial relation between the left and right child nodes.
+  // Since isobutane fits into a single leaf node, the tree is also built for a
+  // lattice of atoms, whose coordinates are sorted like in many structure files.
+  // This test checks the spatial relation between each node and all atoms of its
+  // subtree, and that every atom belongs to exactly one node.
   {
-    std::vector<const AtomNode*> treenodes;
-    std::vector<unsigned char> depth;
+    const AtomTree lattice_tree(lattice(12));
+    for (const AtomTree* tree : {&atomtree, &lattice_tree}) {
+      const std::vector<Atom>& atoms = tree->getAtomList();
+      std::vector<int> n_held(atoms.size(), 0);
+      std::vector<AtomNode> treenodes = {tree->getRoot()};
+
+      while (!treenodes.empty()) {
+        const AtomNode node = treenodes.back();
+        treenodes.pop_back();
+        for (size_t id = node.getAtomId(); id < node.getAtomId() + node.getNumAtoms(); ++id) {
+          n_held[id]++;
+        }
+        if (node.isLeaf()) continue;
+
+        REQUIRE((node.getNumAtoms() == 1));
+        const char d = node.getDim();
+        const double median = tree->getAtom(node).getCoordinate(d);
+        const AtomNode left = node.getLeftChild();
+        const AtomNode right = node.getRightChild();
+        for (size_t id = left.getFirst(); id < left.getEnd(); ++id) {
+          REQUIRE((atoms[id].getCoordinate(d) <= median));
+        }
+        for (size_t id = right.getFirst(); id < right.getEnd(); ++id) {
+          REQUIRE((atoms[id].getCoordinate(d) >= median));
+        }
+        treenodes.push_back(left);
+        treenodes.push_back(right);
+      }
+      for (int n : n_held) {
+        REQUIRE((n == 1));
+      }
+    }
+  }
+
+  // TEST: Neighbour search in a larger tree
+  // In the lattice with a spacing of 1, the atoms within a distance of 1.1 of an
+  // atom's surface are the atom itself and its 6 direct neighbours, unless the
+  // atom lies on the surface of the lattice.
+  {
+    const AtomTree lattice_tree(lattice(12));
+    const std::vector<Atom>& atoms = lattice_tree.getAtomList();
+    for (size_t at_id = 0; at_id < atoms.size(); ++at_id) {
+      std::vector<size_t> closest = lattice_tree.listAllWithin(atoms[at_id].getPos(), 1.1 - atoms[at_id].rad);
+      size_t n_expected = 1;
+      for (char dim = 0; dim < 3; ++dim) {
+        const double coord = atoms[at_id].getCoordinate(dim);
+        n_expected += (coord > 0) + (coord < 11);
+      }
+      REQUIRE((closest.size() == n_expected));
+    }
+  }
 
-    treenodes.push_back(atomtree.getRoot());
-    depth.push_back(0);
+  // TEST: Pruning with the bounds of each subtree
+  // A single large atom must neither be missed, nor loosen the pruning in the
+  // subtrees that do not contain it. The search results are compared against all
+  // atoms, and a search far away from the large atom must visit only a small part
+  // of the tree.
+  {
+    std::vector<Atom> atoms = lattice(12);
+    atoms[0].rad = 6;
+    const AtomTree lattice_tree(atoms);
+    const std::vector<Atom>& tree_atoms = lattice_tree.getAtomList();
+    for (const Atom& at : tree_atoms) {
+      std::vector<size_t> closest = lattice_tree.listAllWithin(at.getPos(), 0.5);
+      size_t n_expected = 0;
+      for (const Atom& at2 : tree_atoms) {
+        n_expected += distance(at.getPos(), at2.getPos()) <= 0.5 + at2.rad;
+      }
+      REQUIRE((closest.size() == n_expected));
+    }
 
+    size_t n_nodes = 0;
+    std::vector<AtomNode> treenodes = {lattice_tree.getRoot()};
     while (!treenodes.empty()) {
-      const AtomNode* node = treenodes[treenodes.size()-1];
+      const AtomNode node = treenodes.back();
       treenodes.pop_back();
-      unsigned char d = depth[depth.size()-1];
-      depth.pop_back();
-      const AtomNode* left = node->getLeftChild();
-      const AtomNode* right = node->getRightChild();
-
-      if (left && right) {
-        if (!(left->getAtom().getCoordinate(d%3) <= right->getAtom().getCoordinate(d%3))) return -1;
-
-        treenodes.push_back(left);
-        treenodes.push_back(right);
-        depth.push_back(d+1);
-        depth.push_back(d+1);
-      }
+      n_nodes++;
+      if (node.isLeaf()) continue;
+      treenodes.push_back(node.getLeftChild());
+      treenodes.push_back(node.getRightChild());
     }
+    size_t n_visited = 0;
+    lattice_tree.listAllWithin({11, 11, 11}, 0.5, &n_visited);
+    REQUIRE((n_visited < n_nodes/4));
   }
 
   std::map<std::string,int> valence = {
@@ -126,4 +192,17 @@ std::vector<Atom> isobutane() {
   }
 
   return at_vec;
-}
\ No newline at end of file
+}
+
+// cubic lattice of n*n*n atoms with a spacing of 1, in the order of their coordinates
+std::vector<Atom> lattice(const int n) {
+  std::vector<Atom> at_vec;
+  for (int x = 0; x < n; ++x) {
+    for (int y = 0; y < n; ++y) {
+      for (int z = 0; z < n; ++z) {
+        at_vec.push_back(Atom(x, y, z, "C", 0.3, 6, 0));
+      }
+    }
+  }
+  return at_vec;
+}
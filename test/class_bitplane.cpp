@@ -0,0 +1,60 @@
+#include "bitplane.h"
+#include <array>
+
+// Using this macro for future compatibility with Catch2
+# define REQUIRE(x) if (!(x)) return -1;
+
+int main() {
+
+  // TEST: Bits are set and read at their index inside the box
+  {
+    BitPlane plane({2, 3, 4}, {75, 6, 8});
+    REQUIRE(plane.getNumWordsPerRow() == 2);
+    plane.setBit({2, 3, 4});
+    plane.setBit({66, 5, 7});
+    plane.setBit({74, 5, 7});
+    REQUIRE(plane.getBit({2, 3, 4}));
+    REQUIRE(plane.getBit({66, 5, 7}));
+    REQUIRE(!plane.getBit({3, 3, 4}));
+    REQUIRE(!plane.getBit({2, 4, 4}));
+    REQUIRE(!plane.getBit({2, 3, 5}));
+  }
+
+  // TEST: Words hold 64 consecutive voxels along x, rows start with a new word
+  {
+    BitPlane plane({2, 3, 4}, {75, 6, 8});
+    plane.setBit({2, 3, 4});
+    plane.setBit({66, 5, 7});
+    plane.setBit({74, 5, 7});
+    REQUIRE(plane.getWord(0, 3, 4) == 1);
+    REQUIRE(plane.getWord(1, 3, 4) == 0);
+    REQUIRE(plane.getWord(0, 5, 7) == 0);
+    REQUIRE(plane.getWord(1, 5, 7) == ((BitPlane::word_type(1) << 8) | 1));
+    // past the end of the row
+    REQUIRE(plane.getWord(2, 5, 7) == 0);
+  }
+
+  // TEST: Runs of bits are set within a word and across words
+  {
+    BitPlane plane({2, 3, 4}, {200, 6, 8});
+    plane.setBits({5, 3, 4}, 3);
+    REQUIRE(plane.getWord(0, 3, 4) == 0b111000);
+    plane.setBits({60, 4, 4}, 140);
+    REQUIRE(plane.getWord(0, 4, 4) == ~BitPlane::word_type(0) << 58);
+    REQUIRE(plane.getWord(1, 4, 4) == ~BitPlane::word_type(0));
+    REQUIRE(plane.getWord(2, 4, 4) == ~BitPlane::word_type(0));
+    REQUIRE(plane.getWord(3, 4, 4) == 0b111111);
+    REQUIRE(plane.getBit({199, 4, 4}));
+    REQUIRE(!plane.getBit({59, 4, 4}));
+    REQUIRE(plane.getWord(0, 5, 4) == 0);
+    plane.setBits({7, 5, 4}, 0);
+    REQUIRE(plane.getWord(0, 5, 4) == 0);
+  }
+
+  // TEST: An empty box has no words
+  {
+    BitPlane plane({5, 5, 5}, {5, 9, 9});
+    REQUIRE(plane.getNumWordsPerRow() == 0);
+    REQUIRE(plane.getWord(0, 6, 6) == 0);
+  }
+}
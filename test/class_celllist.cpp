@@ -0,0 +1,143 @@
+#include "atom.h"
+#include "atomtree.h"
+#include "celllist.h"
+#include "misc.h"
+#include <vector>
+#include <random>
+#include <algorithm>
+
+// Using this macro for future compatibility with Catch2
+# define REQUIRE(x) if (!(x)) return -1;
+
+std::vector<Atom> lattice(const int);
+std::vector<Atom> randomBox(const size_t, const double);
+template<typename T>
+bool classificationAgrees(const CellList&, const AtomTree&, const double);
+
+int main() {
+
+  // TEST: Atoms are sorted by cell
+  // Every atom lies in the cell that the cell list stores it in, and the cells are
+  // stored in row-major order with x running fastest.
+  {
+    const CellList cells(lattice(12), 2.5);
+    const std::vector<Atom>& atoms = cells.getAtomList();
+    REQUIRE(atoms.size() == 12*12*12);
+    REQUIRE(cells.getOccupancy() == 1);
+    const std::array<size_t,3>& n_cells = cells.getNumCells();
+    size_t prev_cell = 0;
+    for (const Atom& at : atoms) {
+      std::array<size_t,3> cell;
+      for (char dim = 0; dim < 3; ++dim) {
+        cell[dim] = at.getCoordinate(dim) / cells.getCellSize();
+        REQUIRE(cell[dim] < n_cells[dim]);
+      }
+      const size_t cell_index = cell[0] + n_cells[0] * (cell[1] + n_cells[1] * cell[2]);
+      REQUIRE(cell_index >= prev_cell);
+      prev_cell = cell_index;
+    }
+  }
+
+  // TEST: Sparse structures do not create many empty cells
+  // Two atoms far apart would need a huge grid with the requested cell size.
+  {
+    const std::vector<Atom> atoms = {Atom(0,0,0,"C",1.7,6,0), Atom(1000,1000,1000,"C",1.7,6,0)};
+    const CellList cells(atoms, 3);
+    const std::array<size_t,3>& n_cells = cells.getNumCells();
+    REQUIRE(n_cells[0] * n_cells[1] * n_cells[2] <= CellList::s_max_cells_per_atom * atoms.size());
+    REQUIRE(cells.listAllWithin({1000,1000,1000}, 0).size() == 1);
+  }
+
+  // TEST: Neighbour search agrees with the atom tree
+  // The ids refer to different atom lists, so the positions of the atoms are compared.
+  {
+    const std::vector<Atom> atoms = randomBox(2000, 20);
+    const CellList cells(atoms, 2);
+    const AtomTree tree(atoms);
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> coord(-3, 23), dist(0, 4);
+    for (int rep = 0; rep < 500; ++rep) {
+      const Atom::pos_type pos = {coord(gen), coord(gen), coord(gen)};
+      const double max_dist = dist(gen);
+      std::vector<Atom::pos_type> found_cells, found_tree;
+      for (size_t id : cells.listAllWithin(pos, max_dist)) {found_cells.push_back(cells.getAtomList()[id].getPos());}
+      for (size_t id : tree.listAllWithin(pos, max_dist)) {found_tree.push_back(tree.getAtomList()[id].getPos());}
+      std::sort(found_cells.begin(), found_cells.end());
+      std::sort(found_tree.begin(), found_tree.end());
+      REQUIRE(found_cells == found_tree);
+    }
+  }
+
+  // TEST: Voxel classification agrees with the atom tree
+  // Both indices combine the same relations and select the same atoms, although
+  // in a different order. The probe radius may be negative. In single precision,
+  // the rounding errors grow with the coordinates, which is tested with a box that
+  // is far away from the origin.
+  {
+    const std::vector<Atom> atoms = randomBox(2000, 20);
+    REQUIRE(classificationAgrees<double>(CellList(atoms, 3), AtomTree(atoms), 0));
+    REQUIRE(classificationAgrees<float>(CellList(atoms, 3), AtomTree(atoms), 0));
+    std::vector<Atom> far_atoms = atoms;
+    for (Atom& atom : far_atoms) {atom.pos_x += 1000;}
+    REQUIRE(classificationAgrees<float>(CellList(far_atoms, 3), AtomTree(far_atoms), 1000));
+  }
+}
+
+// cubic lattice of n*n*n atoms with a spacing of 1, in the order of their coordinates
+std::vector<Atom> lattice(const int n) {
+  std::vector<Atom> at_vec;
+  for (int x = 0; x < n; ++x) {
+    for (int y = 0; y < n; ++y) {
+      for (int z = 0; z < n; ++z) {
+        at_vec.push_back(Atom(x, y, z, "C", 0.3, 6, 0));
+      }
+    }
+  }
+  return at_vec;
+}
+
+// atoms with random positions in a cube and random radii
+std::vector<Atom> randomBox(const size_t n, const double size) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> coord(0, size), radius(0.5, 2);
+  std::vector<Atom> at_vec;
+  for (size_t i = 0; i < n; ++i) {
+    at_vec.push_back(Atom(coord(gen), coord(gen), coord(gen), "C", radius(gen), 6, 0));
+  }
+  return at_vec;
+}
+
+// classifies random voxels in the box of randomBox(n, 20), which is shifted along x
+template<typename T>
+bool classificationAgrees(const CellList& cells, const AtomTree& tree, const double shift_x) {
+  AtomKernel::Stack<T> stack_cells, stack_tree;
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<double> coord(-3, 23), voxel(0, 2), probe(-0.5, 1.5);
+  for (int rep = 0; rep < 2000; ++rep) {
+    const AtomKernel::Query<T> query = {{T(coord(gen) + shift_x), T(coord(gen)), T(coord(gen))}, T(voxel(gen)), T(probe(gen))};
+    const T rad_select = rep % 2? -1 : voxel(gen);
+    unsigned char rel_cells = mvREL_NONE, rel_tree = mvREL_NONE;
+    cells.classifyVoxel(query, rel_cells, rad_select, stack_cells);
+    tree.classifyVoxel(query, rel_tree, rad_select, stack_tree);
+    // the search ends early, if the voxel is inside an atom, so that the other
+    // relations are incomplete
+    if ((rel_cells & mvREL_INSIDE) || (rel_tree & mvREL_INSIDE)) {
+      if (!((rel_cells & mvREL_INSIDE) && (rel_tree & mvREL_INSIDE))) {return false;}
+    }
+    else if (rel_cells != rel_tree) {return false;}
+    if (rad_select < 0 || (rel_tree & mvREL_INSIDE)) {
+      stack_cells.pop(0);
+      stack_tree.pop(0);
+      continue;
+    }
+    if (stack_cells.size() != stack_tree.size()) {return false;}
+    std::vector<T> x_cells(stack_cells.getBucket(0).x, stack_cells.getBucket(0).x + stack_cells.size());
+    std::vector<T> x_tree(stack_tree.getBucket(0).x, stack_tree.getBucket(0).x + stack_tree.size());
+    std::sort(x_cells.begin(), x_cells.end());
+    std::sort(x_tree.begin(), x_tree.end());
+    if (x_cells != x_tree) {return false;}
+    stack_cells.pop(0);
+    stack_tree.pop(0);
+  }
+  return true;
+}
@@ -0,0 +1,83 @@
+#include "container3d.h"
+#include <vector>
+#include <array>
+
+// Using this macro for future compatibility with Catch2
+# define REQUIRE(x) if (!(x)) return -1;
+
+// Every element has its own position in memory, which is inside the underlying vector
+template <class Layout>
+bool isBijective(const std::array<unsigned long,3> n){
+  const Layout layout(n);
+  std::vector<bool> used(layout.size(), false);
+  for (unsigned long x = 0; x < n[0]; ++x){
+    for (unsigned long y = 0; y < n[1]; ++y){
+      for (unsigned long z = 0; z < n[2]; ++z){
+        const size_t i = layout.calcIndex(x, y, z);
+        if (i >= used.size() || used[i]) return false;
+        used[i] = true;
+      }
+    }
+  }
+  return true;
+}
+
+int main() {
+
+  // TEST: Row-major layout without padding, x changes fastest
+  {
+    const std::array<unsigned long,3> n = {3, 4, 5};
+    const RowMajorLayout layout(n);
+    REQUIRE(layout.size() == 60);
+    REQUIRE(layout.calcIndex(1, 0, 0) == 1);
+    REQUIRE(layout.calcIndex(0, 1, 0) == 3);
+    REQUIRE(layout.calcIndex(0, 0, 1) == 12);
+    REQUIRE(isBijective<RowMajorLayout>(n));
+  }
+
+  // TEST: Morton layout is padded to whole bricks and every element has a unique position
+  {
+    const std::array<unsigned long,3> n = {3, 9, 17};
+    REQUIRE(MortonLayout(n).size() == 1*2*3*512);
+    REQUIRE(isBijective<MortonLayout>(n));
+    REQUIRE(isBijective<MortonLayout>({16, 16, 16}));
+  }
+
+  // TEST: In the Morton layout, the 8 subvoxels of a voxel are contiguous and in octant order
+  {
+    const MortonLayout layout({16, 16, 16});
+    for (unsigned long x = 0; x < 16; x += 2){
+      for (unsigned long y = 0; y < 16; y += 2){
+        for (unsigned long z = 0; z < 16; z += 2){
+          const size_t first = layout.calcIndex(x, y, z);
+          REQUIRE(first % 8 == 0);
+          for (unsigned long i = 0; i < 8; ++i){
+            REQUIRE(layout.calcIndex(x + (i>>2), y + ((i>>1)&1), z + (i&1)) == first + i);
+          }
+        }
+      }
+    }
+  }
+
+  // TEST: Elements are accessed by their x,y,z index regardless of the layout
+  {
+    Container3D<int> row_major(5, 6, 7);
+    Container3D<int,MortonLayout> morton(5, 6, 7);
+    for (int x = 0; x < 5; ++x){
+      for (int y = 0; y < 6; ++y){
+        for (int z = 0; z < 7; ++z){
+          row_major.getElement(x, y, z) = 100*x + 10*y + z;
+          morton.getElement(std::array<int,3>{x, y, z}) = 100*x + 10*y + z;
+        }
+      }
+    }
+    for (int x = 0; x < 5; ++x){
+      for (int y = 0; y < 6; ++y){
+        for (int z = 0; z < 7; ++z){
+          REQUIRE(row_major.getElement(x, y, z) == morton.getElement(x, y, z));
+        }
+      }
+    }
+    REQUIRE(morton.getNumElements()[2] == 7);
+  }
+}
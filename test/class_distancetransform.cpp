@@ -0,0 +1,76 @@
+#include "distancetransform.h"
+#include "threadpool.h"
+#include <vector>
+#include <array>
+#include <random>
+#include <algorithm>
+
+// Using this macro for future compatibility with Catch2
+# define REQUIRE(x) if (!(x)) return -1;
+
+// squared distance to the closest feature by comparing all pairs of voxels
+unsigned bruteForce(const std::vector<std::array<unsigned,3>>& features, const std::array<unsigned,3>& index){
+  unsigned min_dist = ~0u;
+  for (const auto& feature : features){
+    unsigned dist = 0;
+    for (char dim = 0; dim < 3; ++dim){
+      const int diff = int(feature[dim]) - int(index[dim]);
+      dist += diff * diff;
+    }
+    min_dist = std::min(min_dist, dist);
+  }
+  return min_dist;
+}
+
+int main() {
+
+  // TEST: A box without features is at the limit everywhere
+  {
+    DistanceTransform dt({4,3,2}, 10);
+    dt.compute(ThreadPool(1));
+    REQUIRE(dt.getValue({0,0,0}) == 11);
+    REQUIRE(dt.getValue({3,2,1}) == 11);
+    REQUIRE(!dt.isFeature({1,1,1}));
+  }
+
+  // TEST: Distances to a single feature
+  {
+    DistanceTransform dt({6,6,6}, 100);
+    dt.setFeature({1,2,3});
+    dt.compute(ThreadPool(1));
+    REQUIRE(dt.isFeature({1,2,3}));
+    REQUIRE(dt.getValue({2,2,3}) == 1);
+    REQUIRE(dt.getValue({0,1,2}) == 3);
+    REQUIRE(dt.getValue({5,5,5}) == 16 + 9 + 4);
+  }
+
+  // TEST: Random features agree with the brute force distance, up to the limit
+  // The lines along y and z are transformed in batches, so that the box is chosen wider than a
+  // batch along x and the result must not depend on the number of threads.
+  {
+    const std::array<unsigned,3> size = {21,7,9};
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<unsigned> dist_x(0, size[0]-1), dist_y(0, size[1]-1), dist_z(0, size[2]-1);
+    std::vector<std::array<unsigned,3>> features;
+    for (int i = 0; i < 6; ++i) {
+      features.push_back({dist_x(gen), dist_y(gen), dist_z(gen)});
+    }
+    for (const unsigned limit : {1000u, 12u}) {
+      for (const unsigned n_threads : {1u, 3u}) {
+        DistanceTransform dt(size, limit);
+        for (const auto& feature : features) {
+          dt.setFeature(feature);
+        }
+        dt.compute(ThreadPool(n_threads));
+        std::array<unsigned,3> index;
+        for (index[2] = 0; index[2] < size[2]; ++index[2]) {
+          for (index[1] = 0; index[1] < size[1]; ++index[1]) {
+            for (index[0] = 0; index[0] < size[0]; ++index[0]) {
+              REQUIRE(dt.getValue(index) == std::min(bruteForce(features, index), limit + 1));
+            }
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#include "unionfind.h"
+#include <vector>
+#include <array>
+#include <algorithm>
+
+// Using this macro for future compatibility with Catch2
+# define REQUIRE(x) if (!(x)) return -1;
+
+int main() {
+
+  // TEST: Every element starts out as its own set
+  {
+    UnionFind sets(5);
+    REQUIRE(sets.size() == 5);
+    for (size_t i = 0; i < sets.size(); ++i) {
+      REQUIRE(sets.isRoot(i));
+      REQUIRE(sets.find(i) == i);
+    }
+  }
+
+  // TEST: Merged sets share the root, which is their smallest element
+  {
+    UnionFind sets(8);
+    sets.unite(6, 3);
+    sets.unite(3, 7);
+    sets.unite(1, 4);
+    sets.unite(7, 6); // already in the same set
+
+    for (size_t i : {3, 6, 7}) REQUIRE(sets.find(i) == 3);
+    for (size_t i : {1, 4}) REQUIRE(sets.find(i) == 1);
+    for (size_t i : {0, 2, 5}) REQUIRE(sets.isRoot(i));
+
+    sets.unite(4, 6);
+    for (size_t i : {1, 3, 4, 6, 7}) REQUIRE(sets.find(i) == 1);
+  }
+
+  // TEST: The roots do not depend on the order of the merges
+  // The cavity labelling relies on this to assign IDs that are independent of the number
+  // of threads. Here the same merges are applied in reversed order.
+  {
+    const std::vector<std::array<size_t,2>> pairs = {
+      {9, 2}, {5, 11}, {0, 8}, {11, 2}, {14, 7}, {3, 13}, {8, 12}, {13, 7}
+    };
+    UnionFind forward(15);
+    UnionFind backward(15);
+    for (const auto& pair : pairs) {
+      forward.unite(pair[0], pair[1]);
+    }
+    for (auto it = pairs.rbegin(); it != pairs.rend(); ++it) {
+      backward.unite((*it)[1], (*it)[0]);
+    }
+    for (size_t i = 0; i < 15; ++i) {
+      REQUIRE(forward.find(i) == backward.find(i));
+    }
+    REQUIRE(forward.find(12) == 0);
+    REQUIRE(forward.find(5) == 2);
+    REQUIRE(forward.find(14) == 3);
+  }
+}